@@ -14,6 +14,7 @@ http://www.raspberrypi.org/wp-content/uploads/2012/02/BCM2835-ARM-Peripherals.pd
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,9 @@ http://www.raspberrypi.org/wp-content/uploads/2012/02/BCM2835-ARM-Peripherals.pd
 #define BCK2835_LIBRARY_BUILD
 #include "bcm2835.h"
 
+#include <l4/re/env.h>
+#include <l4/sys/kip.h>
+
 /* This define enables a little test program (by default a blinking output on
 pin RPI_GPIO_PIN_11)
 // You can do some safe, non-destructive testing on any platform with:
@@ -50,8 +54,9 @@ size_t bcm2835_peripherals_size = BCM2835_PERI_SIZE;
  */
 uint32_t *bcm2835_peripherals = (uint32_t *)MAP_FAILED;
 
-/* And the register bases within the peripherals block
- */
+/* And the register bases of the peripheral blocks, each its own window
+// attached by bcm2835_map_peripherals()
+*/
 volatile uint32_t *bcm2835_gpio = (uint32_t *)MAP_FAILED;
 volatile uint32_t *bcm2835_clk = (uint32_t *)MAP_FAILED;
 volatile uint32_t *bcm2835_pads = (uint32_t *)MAP_FAILED;
@@ -59,6 +64,39 @@ volatile uint32_t *bcm2835_spi0 = (uint32_t *)MAP_FAILED;
 volatile uint32_t *bcm2835_st = (uint32_t *)MAP_FAILED;
 volatile uint32_t *bcm2835_aux = (uint32_t *)MAP_FAILED;
 volatile uint32_t *bcm2835_spi1 = (uint32_t *)MAP_FAILED;
+volatile uint32_t *bcm2835_spi2 = (uint32_t *)MAP_FAILED;
+volatile uint32_t *bcm2835_bsc0 = (uint32_t *)MAP_FAILED;
+volatile uint32_t *bcm2835_bsc1 = (uint32_t *)MAP_FAILED;
+
+/* Time base of bcm2835_nanos(), see bcm2835_clock_init()
+ */
+static uint8_t bcm2835_clock = BCM2835_CLOCK_KIP;
+
+#if defined(__aarch64__)
+/* Generic timer ticks to nanoseconds, as a 32.32 fixed point factor
+ */
+static uint64_t bcm2835_cntvct_mult;
+#endif
+
+/* Register fields the code composes values for, see Bcm2835_field. The
+// masks are checked against the register definitions of bcm2835.h.
+*/
+typedef Bcm2835_field<2, 2> Spi0_cs_mode;        /* CPOL and CPHA */
+typedef Bcm2835_field<0, 6> Aux_cntl0_shiftlen;
+typedef Bcm2835_field<17, 3> Aux_cntl0_cs;
+typedef Bcm2835_field<20, 12> Aux_cntl0_speed;
+
+static_assert(Spi0_cs_mode::mask ==
+                  (BCM2835_SPI0_CS_CPOL | BCM2835_SPI0_CS_CPHA),
+              "SPI0 mode field");
+static_assert(Aux_cntl0_shiftlen::mask == BCM2835_AUX_SPI_CNTL0_SHIFTLEN,
+              "AUX shift length field");
+static_assert(Aux_cntl0_cs::mask == (BCM2835_AUX_SPI_CNTL0_CS0_N |
+                                     BCM2835_AUX_SPI_CNTL0_CS1_N |
+                                     BCM2835_AUX_SPI_CNTL0_CS2_N),
+              "AUX chip select field");
+static_assert(Aux_cntl0_speed::mask == BCM2835_AUX_SPI_CNTL0_SPEED,
+              "AUX speed field");
 
 /* This variable allows us to test on hardware other than RPi.
 // It prevents access to the kernel memory, and does not do any peripheral
@@ -129,12 +167,16 @@ uint32_t *bcm2835_regbase(uint8_t regbase) {
     return (uint32_t *)bcm2835_pads;
   case BCM2835_REGBASE_SPI0:
     return (uint32_t *)bcm2835_spi0;
+  case BCM2835_REGBASE_BSC0:
+    return (uint32_t *)bcm2835_bsc0;
   case BCM2835_REGBASE_BSC1:
-    return (uint32_t *)bcm2835_st;
+    return (uint32_t *)bcm2835_bsc1;
   case BCM2835_REGBASE_AUX:
     return (uint32_t *)bcm2835_aux;
   case BCM2835_REGBASE_SPI1:
     return (uint32_t *)bcm2835_spi1;
+  case BCM2835_REGBASE_SPI2:
+    return (uint32_t *)bcm2835_spi2;
   }
   return (uint32_t *)MAP_FAILED;
 }
@@ -153,6 +195,22 @@ void bcm2835_peri_set_bits(volatile uint32_t *paddr, uint32_t value,
   bcm2835_peri_write(paddr, v);
 }
 
+/* Registers shared by the worker threads of different buses are changed
+// under the lock of their block: GPFSELn and the detect enables under
+// bcm2835_gpio_lock, AUX_ENABLE under bcm2835_aux_lock. Registers owned by
+// one bus, like SPI0 CS, use the plain bcm2835_peri_set_bits.
+*/
+static pthread_mutex_t bcm2835_gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t bcm2835_aux_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void bcm2835_locked_set_bits(pthread_mutex_t *lock,
+                                    volatile uint32_t *paddr, uint32_t value,
+                                    uint32_t mask) {
+  pthread_mutex_lock(lock);
+  bcm2835_peri_set_bits(paddr, value, mask);
+  pthread_mutex_unlock(lock);
+}
+
 /*
 // Low level convenience functions
 */
@@ -176,12 +234,62 @@ void bcm2835_peri_set_bits(volatile uint32_t *paddr, uint32_t value,
 //      X / 10 + ((X % 10) * 3)
 */
 void bcm2835_gpio_fsel(uint8_t pin, uint8_t mode) {
+  bcm2835FselBatch batch = BCM2835_FSEL_BATCH_INIT;
+
+  bcm2835_gpio_fsel_stage(&batch, pin, mode);
+  bcm2835_gpio_fsel_commit(&batch);
+}
+
+/* Copy of the GPFSEL registers, loaded by bcm2835_init() and kept up to
+// date under bcm2835_gpio_lock. The driver owns the GPIO block, so nobody
+// else changes them behind its back.
+*/
+static uint32_t bcm2835_fsel_shadow[BCM2835_GPFSEL_COUNT];
+
+void bcm2835_gpio_fsel_stage(bcm2835FselBatch *batch, uint8_t pin,
+                             uint8_t mode) {
   /* Function selects are 10 pins per 32 bit word, 3 bits per pin */
-  volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPFSEL0 / 4 + (pin / 10);
+  uint8_t reg = pin / 10;
   uint8_t shift = (pin % 10) * 3;
-  uint32_t mask = BCM2835_GPIO_FSEL_MASK << shift;
-  uint32_t value = mode << shift;
-  bcm2835_peri_set_bits(paddr, value, mask);
+
+  if (reg >= BCM2835_GPFSEL_COUNT)
+    return;
+
+  batch->mask[reg] |= BCM2835_GPIO_FSEL_MASK << shift;
+  batch->value[reg] &= ~(BCM2835_GPIO_FSEL_MASK << shift);
+  batch->value[reg] |= (mode & BCM2835_GPIO_FSEL_MASK) << shift;
+}
+
+void bcm2835_gpio_fsel_commit(const bcm2835FselBatch *batch) {
+  volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPFSEL0 / 4;
+  uint32_t v;
+  int i;
+
+  pthread_mutex_lock(&bcm2835_gpio_lock);
+  for (i = 0; i < BCM2835_GPFSEL_COUNT; i++) {
+    v = (bcm2835_fsel_shadow[i] & ~batch->mask[i]) | batch->value[i];
+    if (v == bcm2835_fsel_shadow[i])
+      continue;
+
+    bcm2835_peri_write(paddr + i, v);
+    bcm2835_fsel_shadow[i] = v;
+  }
+  pthread_mutex_unlock(&bcm2835_gpio_lock);
+}
+
+uint8_t bcm2835_gpio_get_fsel(uint8_t pin) {
+  uint8_t reg = pin / 10;
+  uint8_t shift = (pin % 10) * 3;
+  uint32_t v;
+
+  if (reg >= BCM2835_GPFSEL_COUNT)
+    return BCM2835_GPIO_FSEL_INPT;
+
+  pthread_mutex_lock(&bcm2835_gpio_lock);
+  v = bcm2835_fsel_shadow[reg];
+  pthread_mutex_unlock(&bcm2835_gpio_lock);
+
+  return (v >> shift) & BCM2835_GPIO_FSEL_MASK;
 }
 
 /* Set output pin */
@@ -218,6 +326,13 @@ uint8_t bcm2835_gpio_lev(uint8_t pin) {
   return (value & (1 << shift)) ? HIGH : LOW;
 }
 
+/* Read all input pins in the mask */
+uint32_t bcm2835_gpio_lev_multi(uint32_t mask) {
+  volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPLEV0 / 4;
+  uint32_t value = bcm2835_peri_read(paddr);
+  return (value & mask);
+}
+
 /* See if an event detection bit is set
 // Sigh cant support interrupts yet
 */
@@ -252,13 +367,13 @@ void bcm2835_gpio_ren(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPREN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, value, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, value, value);
 }
 void bcm2835_gpio_clr_ren(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPREN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, 0, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, 0, value);
 }
 
 /* Falling edge detect enable */
@@ -266,13 +381,29 @@ void bcm2835_gpio_fen(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPFEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, value, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, value, value);
 }
 void bcm2835_gpio_clr_fen(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPFEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, 0, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, 0, value);
+}
+
+/* Rising and falling edge detect enables of all pins in mask at once. Both
+// registers are updated under one hold of the lock, with one write each.
+*/
+void bcm2835_gpio_edges_multi(uint32_t rising, uint32_t falling,
+                              uint32_t mask) {
+  volatile uint32_t *ren = bcm2835_gpio + BCM2835_GPREN0 / 4;
+  volatile uint32_t *fen = bcm2835_gpio + BCM2835_GPFEN0 / 4;
+
+  pthread_mutex_lock(&bcm2835_gpio_lock);
+  uint32_t v = bcm2835_peri_read(ren);
+  bcm2835_peri_write(ren, (v & ~mask) | (rising & mask));
+  v = bcm2835_peri_read(fen);
+  bcm2835_peri_write(fen, (v & ~mask) | (falling & mask));
+  pthread_mutex_unlock(&bcm2835_gpio_lock);
 }
 
 /* High detect enable */
@@ -280,13 +411,13 @@ void bcm2835_gpio_hen(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPHEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, value, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, value, value);
 }
 void bcm2835_gpio_clr_hen(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPHEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, 0, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, 0, value);
 }
 
 /* Low detect enable */
@@ -294,13 +425,13 @@ void bcm2835_gpio_len(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPLEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, value, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, value, value);
 }
 void bcm2835_gpio_clr_len(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPLEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, 0, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, 0, value);
 }
 
 /* Async rising edge detect enable */
@@ -308,13 +439,13 @@ void bcm2835_gpio_aren(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPAREN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, value, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, value, value);
 }
 void bcm2835_gpio_clr_aren(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPAREN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, 0, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, 0, value);
 }
 
 /* Async falling edge detect enable */
@@ -322,13 +453,13 @@ void bcm2835_gpio_afen(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPAFEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, value, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, value, value);
 }
 void bcm2835_gpio_clr_afen(uint8_t pin) {
   volatile uint32_t *paddr = bcm2835_gpio + BCM2835_GPAFEN0 / 4 + pin / 32;
   uint8_t shift = pin % 32;
   uint32_t value = 1 << shift;
-  bcm2835_peri_set_bits(paddr, 0, value);
+  bcm2835_locked_set_bits(&bcm2835_gpio_lock, paddr, 0, value);
 }
 
 /* Set pullup/down */
@@ -400,25 +531,25 @@ void bcm2835_delayMicroseconds(uint64_t micros) {
   }
 
   /* Calling nanosleep() takes at least 100-200 us, so use it for
-  // long waits and use a busy wait on the System Timer for the rest.
+  // long waits and use a busy wait on the clock source for the rest.
   */
-  start = bcm2835_st_read();
-
-  /* Not allowed to access timer registers (result is not as precise)*/
-  if (start == 0) {
+  /* The KIP clock is too coarse to busy wait on (result is not as precise)*/
+  if (bcm2835_clock == BCM2835_CLOCK_KIP) {
     t1.tv_sec = 0;
     t1.tv_nsec = 1000 * (long)(micros);
     nanosleep(&t1, NULL);
     return;
   }
 
+  start = bcm2835_micros();
+
   if (micros > 450) {
     t1.tv_sec = 0;
     t1.tv_nsec = 1000 * (long)(micros - 200);
     nanosleep(&t1, NULL);
   }
 
-  bcm2835_st_delay(start, micros);
+  bcm2835_delayUntil(start + micros);
 }
 
 /*
@@ -542,14 +673,6 @@ uint8_t bcm2835_gpio_get_pud(uint8_t pin) {
   return ret;
 }
 
-static void bcm2835_aux_spi_reset(void) {
-  volatile uint32_t *cntl0 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL0 / 4;
-  volatile uint32_t *cntl1 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL1 / 4;
-
-  bcm2835_peri_write(cntl1, 0);
-  bcm2835_peri_write(cntl0, BCM2835_AUX_SPI_CNTL0_CLEARFIFO);
-}
-
 int bcm2835_spi_begin(void) {
   volatile uint32_t *paddr;
 
@@ -557,11 +680,14 @@ int bcm2835_spi_begin(void) {
     return 0; /* bcm2835_init() failed, or not root */
 
   /* Set the SPI0 pins to the Alt 0 function to enable SPI0 access on them */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_26, BCM2835_GPIO_FSEL_ALT0); /* CE1 */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_24, BCM2835_GPIO_FSEL_ALT0); /* CE0 */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_21, BCM2835_GPIO_FSEL_ALT0); /* MISO */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_19, BCM2835_GPIO_FSEL_ALT0); /* MOSI */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_23, BCM2835_GPIO_FSEL_ALT0); /* CLK */
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  /* CE1, CE0, MISO, MOSI, CLK */
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_26, BCM2835_GPIO_FSEL_ALT0);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_24, BCM2835_GPIO_FSEL_ALT0);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_21, BCM2835_GPIO_FSEL_ALT0);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_19, BCM2835_GPIO_FSEL_ALT0);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_23, BCM2835_GPIO_FSEL_ALT0);
+  bcm2835_gpio_fsel_commit(&pins);
 
   /* Set the SPI CS register to the some sensible defaults */
   paddr = bcm2835_spi0 + BCM2835_SPI0_CS / 4;
@@ -575,11 +701,14 @@ int bcm2835_spi_begin(void) {
 
 void bcm2835_spi_end(void) {
   /* Set all the SPI0 pins back to input */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_26, BCM2835_GPIO_FSEL_INPT); /* CE1 */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_24, BCM2835_GPIO_FSEL_INPT); /* CE0 */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_21, BCM2835_GPIO_FSEL_INPT); /* MISO */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_19, BCM2835_GPIO_FSEL_INPT); /* MOSI */
-  bcm2835_gpio_fsel(RPI_GPIO_P1_23, BCM2835_GPIO_FSEL_INPT); /* CLK */
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  /* CE1, CE0, MISO, MOSI, CLK */
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_26, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_24, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_21, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_19, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, RPI_GPIO_P1_23, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_commit(&pins);
 }
 
 void bcm2835_spi_setBitOrder(uint8_t order) { bcm2835_spi_bit_order = order; }
@@ -603,8 +732,7 @@ void bcm2835_spi_set_speed_hz(uint32_t speed_hz) {
 void bcm2835_spi_setDataMode(uint8_t mode) {
   volatile uint32_t *paddr = bcm2835_spi0 + BCM2835_SPI0_CS / 4;
   /* Mask in the CPO and CPHA bits of CS */
-  bcm2835_peri_set_bits(paddr, mode << 2,
-                        BCM2835_SPI0_CS_CPOL | BCM2835_SPI0_CS_CPHA);
+  bcm2835_peri_set_bits(paddr, Spi0_cs_mode::val(mode), Spi0_cs_mode::mask);
 }
 
 /* Writes (and reads) a single byte to SPI */
@@ -625,7 +753,7 @@ uint8_t bcm2835_spi_transfer(uint8_t value) {
   bcm2835_peri_set_bits(paddr, BCM2835_SPI0_CS_TA, BCM2835_SPI0_CS_TA);
 
   /* Maybe wait for TXD */
-  while (!(bcm2835_peri_read(paddr) & BCM2835_SPI0_CS_TXD))
+  while (!(bcm2835_peri_read_nb(paddr) & BCM2835_SPI0_CS_TXD))
     ;
 
   /* Write to FIFO, no barrier */
@@ -645,12 +773,12 @@ uint8_t bcm2835_spi_transfer(uint8_t value) {
   return ret;
 }
 
-/* Writes (and reads) an number of bytes to SPI */
-void bcm2835_spi_transfernb(const unsigned char *tbuf, unsigned char *rbuf, uint32_t len) {
+/* Starts a transfer: clears the FIFOs and asserts CS by setting TA.
+// CS stays asserted across bcm2835_spi_transfer_continue() calls until
+// bcm2835_spi_transfer_end().
+*/
+void bcm2835_spi_transfer_begin(void) {
   volatile uint32_t *paddr = bcm2835_spi0 + BCM2835_SPI0_CS / 4;
-  volatile uint32_t *fifo = bcm2835_spi0 + BCM2835_SPI0_FIFO / 4;
-  uint32_t TXCnt = 0;
-  uint32_t RXCnt = 0;
 
   /* This is Polled transfer as per section 10.6.1
   // BUG ALERT: what happens if we get interupted in this section, and someone
@@ -663,22 +791,46 @@ void bcm2835_spi_transfernb(const unsigned char *tbuf, unsigned char *rbuf, uint
 
   /* Set TA = 1 */
   bcm2835_peri_set_bits(paddr, BCM2835_SPI0_CS_TA, BCM2835_SPI0_CS_TA);
+}
+
+/* Transfers len bytes within a started transfer. A NULL tbuf sends zeros,
+// a NULL rbuf discards the received bytes.
+*/
+void bcm2835_spi_transfer_continue(const unsigned char *tbuf,
+                                   unsigned char *rbuf, uint32_t len) {
+  typedef Bcm2835_reg<bcm2835_spi0, BCM2835_SPI0_CS> Cs;
+  typedef Bcm2835_reg<bcm2835_spi0, BCM2835_SPI0_FIFO> Fifo;
+  uint32_t TXCnt = 0;
+  uint32_t RXCnt = 0;
+  uint32_t cs;
+  uint8_t byte;
 
-  /* Use the FIFO's to reduce the interbyte times */
+  /* Use the FIFO's to reduce the interbyte times. transfer_begin() and
+  // transfer_end() fence the peripheral, so the loop itself needs no
+  // barriers.
+  */
   while ((TXCnt < len) || (RXCnt < len)) {
     /* TX fifo not full, so add some more bytes */
-    while (((bcm2835_peri_read(paddr) & BCM2835_SPI0_CS_TXD)) &&
-           (TXCnt < len)) {
-      bcm2835_peri_write_nb(fifo, bcm2835_correct_order(tbuf[TXCnt]));
+    while (((cs = Cs::read_nb()) & BCM2835_SPI0_CS_TXD) && (TXCnt < len)) {
+      byte = tbuf ? tbuf[TXCnt] : 0;
+      Fifo::write_nb(bcm2835_correct_order(byte));
       TXCnt++;
     }
     /* Rx fifo not empty, so get the next received bytes */
-    while (((bcm2835_peri_read(paddr) & BCM2835_SPI0_CS_RXD)) &&
-           (RXCnt < len)) {
-      rbuf[RXCnt] = bcm2835_correct_order(bcm2835_peri_read_nb(fifo));
+    while ((cs & BCM2835_SPI0_CS_RXD) && (RXCnt < len)) {
+      byte = bcm2835_correct_order(Fifo::read_nb());
+      if (rbuf)
+        rbuf[RXCnt] = byte;
       RXCnt++;
+      cs = Cs::read_nb();
     }
   }
+}
+
+/* Waits for the transfer to finish and deasserts CS */
+void bcm2835_spi_transfer_end(void) {
+  volatile uint32_t *paddr = bcm2835_spi0 + BCM2835_SPI0_CS / 4;
+
   /* Wait for DONE to be set */
   while (!(bcm2835_peri_read_nb(paddr) & BCM2835_SPI0_CS_DONE))
     ;
@@ -687,10 +839,18 @@ void bcm2835_spi_transfernb(const unsigned char *tbuf, unsigned char *rbuf, uint
   bcm2835_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_TA);
 }
 
+/* Writes (and reads) an number of bytes to SPI */
+void bcm2835_spi_transfernb(const unsigned char *tbuf, unsigned char *rbuf, uint32_t len) {
+  bcm2835_spi_transfer_begin();
+  bcm2835_spi_transfer_continue(tbuf, rbuf, len);
+  bcm2835_spi_transfer_end();
+}
+
 /* Writes an number of bytes to SPI */
 void bcm2835_spi_writenb(const char *tbuf, uint32_t len) {
+  typedef Bcm2835_reg<bcm2835_spi0, BCM2835_SPI0_CS> Cs;
+  typedef Bcm2835_reg<bcm2835_spi0, BCM2835_SPI0_FIFO> Fifo;
   volatile uint32_t *paddr = bcm2835_spi0 + BCM2835_SPI0_CS / 4;
-  volatile uint32_t *fifo = bcm2835_spi0 + BCM2835_SPI0_FIFO / 4;
   uint32_t i;
 
   /* This is Polled transfer as per section 10.6.1
@@ -708,27 +868,88 @@ void bcm2835_spi_writenb(const char *tbuf, uint32_t len) {
 
   for (i = 0; i < len; i++) {
     /* Maybe wait for TXD */
-    while (!(bcm2835_peri_read(paddr) & BCM2835_SPI0_CS_TXD))
+    while (!(Cs::read_nb() & BCM2835_SPI0_CS_TXD))
       ;
 
     /* Write to FIFO, no barrier */
-    bcm2835_peri_write_nb(fifo, bcm2835_correct_order(tbuf[i]));
+    Fifo::write_nb(bcm2835_correct_order(tbuf[i]));
 
     /* Read from FIFO to prevent stalling */
-    while (bcm2835_peri_read(paddr) & BCM2835_SPI0_CS_RXD)
-      (void)bcm2835_peri_read_nb(fifo);
+    while (Cs::read_nb() & BCM2835_SPI0_CS_RXD)
+      (void)Fifo::read_nb();
   }
 
   /* Wait for DONE to be set */
-  while (!(bcm2835_peri_read_nb(paddr) & BCM2835_SPI0_CS_DONE)) {
-    while (bcm2835_peri_read(paddr) & BCM2835_SPI0_CS_RXD)
-      (void)bcm2835_peri_read_nb(fifo);
+  while (!(Cs::read_nb() & BCM2835_SPI0_CS_DONE)) {
+    while (Cs::read_nb() & BCM2835_SPI0_CS_RXD)
+      (void)Fifo::read_nb();
   };
 
   /* Set TA = 0, and also set the barrier */
   bcm2835_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_TA);
 }
 
+/* Writes 9 bit LoSSI words. LoSSI mode is only enabled for the duration
+// of the transfer, so ordinary transfers on other chip selects are not
+// affected. Bit 8 of each word is the command/data bit.
+*/
+void bcm2835_spi_lossi_writenb(const uint16_t *words, uint32_t len) {
+  typedef Bcm2835_reg<bcm2835_spi0, BCM2835_SPI0_CS> Cs;
+  typedef Bcm2835_reg<bcm2835_spi0, BCM2835_SPI0_FIFO> Fifo;
+  volatile uint32_t *paddr = bcm2835_spi0 + BCM2835_SPI0_CS / 4;
+  uint32_t i;
+  uint16_t word;
+
+  /* Clear TX and RX fifos, enable LoSSI and set TA = 1 */
+  bcm2835_peri_set_bits(paddr,
+                        BCM2835_SPI0_CS_CLEAR | BCM2835_SPI0_CS_LEN |
+                            BCM2835_SPI0_CS_TA,
+                        BCM2835_SPI0_CS_CLEAR | BCM2835_SPI0_CS_LEN |
+                            BCM2835_SPI0_CS_TA);
+
+  for (i = 0; i < len; i++) {
+    while (!(Cs::read_nb() & BCM2835_SPI0_CS_TXD))
+      ;
+
+    word = words[i];
+    Fifo::write_nb((word & BCM2835_SPI_LOSSI_DATA) |
+                bcm2835_correct_order(word & 0xff));
+
+    while (Cs::read_nb() & BCM2835_SPI0_CS_RXD)
+      (void)Fifo::read_nb();
+  }
+
+  while (!(Cs::read_nb() & BCM2835_SPI0_CS_DONE)) {
+    while (Cs::read_nb() & BCM2835_SPI0_CS_RXD)
+      (void)Fifo::read_nb();
+  };
+
+  /* Set TA = 0 and leave LoSSI mode */
+  bcm2835_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_LEN | BCM2835_SPI0_CS_TA);
+}
+
+/* Sends a LoSSI command byte followed by its parameters as data words */
+void bcm2835_spi_lossi_command(uint8_t cmd, const uint8_t *params,
+                               uint32_t len) {
+  uint16_t words[1 + BCM2835_SPI_LOSSI_PARAMS_MAX];
+  uint32_t i;
+
+  if (len > BCM2835_SPI_LOSSI_PARAMS_MAX)
+    len = BCM2835_SPI_LOSSI_PARAMS_MAX;
+
+  words[0] = cmd;
+  for (i = 0; i < len; i++)
+    words[1 + i] = BCM2835_SPI_LOSSI_DATA | params[i];
+
+  bcm2835_spi_lossi_writenb(words, 1 + len);
+}
+
+/* Sets the LoSSI output hold delay in core clock cycles, 1 to 15 */
+void bcm2835_spi_setLoSSIHold(uint8_t toh) {
+  volatile uint32_t *paddr = bcm2835_spi0 + BCM2835_SPI0_LTOH / 4;
+  bcm2835_peri_write(paddr, toh & 0xf);
+}
+
 /* Writes (and reads) an number of bytes to SPI
 // Read bytes are copied over onto the transmit buffer
 */
@@ -760,7 +981,7 @@ void bcm2835_spi_write(uint16_t data) {
   bcm2835_peri_set_bits(paddr, BCM2835_SPI0_CS_TA, BCM2835_SPI0_CS_TA);
 
   /* Maybe wait for TXD */
-  while (!(bcm2835_peri_read(paddr) & BCM2835_SPI0_CS_TXD))
+  while (!(bcm2835_peri_read_nb(paddr) & BCM2835_SPI0_CS_TXD))
     ;
 
   /* Write to FIFO */
@@ -775,36 +996,97 @@ void bcm2835_spi_write(uint16_t data) {
   bcm2835_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_TA);
 }
 
-int bcm2835_aux_spi_begin(void) {
-  volatile uint32_t *enable = bcm2835_aux + BCM2835_AUX_ENABLE / 4;
-  volatile uint32_t *cntl0 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL0 / 4;
-  volatile uint32_t *cntl1 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL1 / 4;
+/* The two AUX SPI controllers. Pins are MISO, MOSI, SCLK, CE0, CE1, CE2.
+// SPI2 is only routed to GPIO 40-45 on the Compute Modules.
+*/
+bcm2835AuxSPI bcm2835_aux_spi1_ctrl = {
+    NULL, BCM2835_AUX_ENABLE_SPI0, 0, BCM2835_AUX_SPI_CNTL0_CS2_N,
+    {RPI_V2_GPIO_P1_35, RPI_V2_GPIO_P1_38, RPI_V2_GPIO_P1_40,
+     RPI_V2_GPIO_P1_12, RPI_V2_GPIO_P1_11, RPI_V2_GPIO_P1_36},
+    0, 0, NULL, NULL, pthread_t()};
+bcm2835AuxSPI bcm2835_aux_spi2_ctrl = {
+    NULL, BCM2835_AUX_ENABLE_SPI1, 0, BCM2835_AUX_SPI_CNTL0_CS2_N,
+    {40, 41, 42, 43, 44, 45}, 0, 0, NULL, NULL, pthread_t()};
+
+static void bcm2835_auxspi_reset(bcm2835AuxSPI *spi) {
+  volatile uint32_t *cntl0 = spi->regs + BCM2835_AUX_SPI_CNTL0 / 4;
+  volatile uint32_t *cntl1 = spi->regs + BCM2835_AUX_SPI_CNTL1 / 4;
 
-  if (bcm2835_spi1 == MAP_FAILED)
-    return 0; /* bcm2835_init() failed, or not root */
+  bcm2835_peri_write(cntl1, 0);
+  bcm2835_peri_write(cntl0, BCM2835_AUX_SPI_CNTL0_CLEARFIFO);
+  spi->cntl0 = BCM2835_AUX_SPI_CNTL0_CLEARFIFO;
+  spi->cntl1 = 0;
+}
 
-  /* Set the SPI pins to the Alt 4 function to enable SPI1 access on them */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_36, BCM2835_GPIO_FSEL_ALT4); /* SPI1_CE2_N */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_35, BCM2835_GPIO_FSEL_ALT4); /* SPI1_MISO */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_38, BCM2835_GPIO_FSEL_ALT4); /* SPI1_MOSI */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_40, BCM2835_GPIO_FSEL_ALT4); /* SPI1_SCLK */
+/* The CNTL0 bits set for every transfer */
+static constexpr uint32_t bcm2835_auxspi_cntl0 =
+    BCM2835_AUX_SPI_CNTL0_ENABLE | BCM2835_AUX_SPI_CNTL0_MSBF_OUT;
 
-  bcm2835_aux_spi_setClockDivider(
-      bcm2835_aux_spi_CalcClockDivider(1000000)); // Default 1MHz SPI
+/* Loads the control words for the next transfer. The registers are only
+// written when the cached value differs, so back to back transfers with
+// the same speed, chip select and width touch neither register. Either
+// way the controller is entered with a barrier, so the transfer routines
+// can use the _nb accessors until they leave it.
+*/
+static void bcm2835_auxspi_control(bcm2835AuxSPI *spi, uint32_t _cntl0,
+                                   uint32_t _cntl1) {
+  volatile uint32_t *cntl0 = spi->regs + BCM2835_AUX_SPI_CNTL0 / 4;
+  volatile uint32_t *cntl1 = spi->regs + BCM2835_AUX_SPI_CNTL1 / 4;
 
-  bcm2835_peri_write(enable, BCM2835_AUX_ENABLE_SPI0);
-  bcm2835_peri_write(cntl1, 0);
-  bcm2835_peri_write(cntl0, BCM2835_AUX_SPI_CNTL0_CLEARFIFO);
+  _cntl0 |= spi->speed | spi->cs | bcm2835_auxspi_cntl0;
+
+  if (_cntl1 == spi->cntl1 && _cntl0 == spi->cntl0) {
+    bcm2835_memory_barrier();
+    return;
+  }
+
+  if (_cntl1 != spi->cntl1) {
+    bcm2835_peri_write(cntl1, _cntl1);
+    spi->cntl1 = _cntl1;
+  }
+  if (_cntl0 != spi->cntl0) {
+    bcm2835_peri_write(cntl0, _cntl0);
+    spi->cntl0 = _cntl0;
+  }
+}
+
+int bcm2835_auxspi_begin(bcm2835AuxSPI *spi) {
+  volatile uint32_t *enable = bcm2835_aux + BCM2835_AUX_ENABLE / 4;
+
+  if (spi->regs == MAP_FAILED || spi->regs == NULL)
+    return 0; /* bcm2835_init() failed, or not root */
+
+  /* Set the SPI pins to the Alt 4 function to enable SPI access on them.
+  // Only CE2 is muxed here, CE0 and CE1 are muxed on first use.
+  */
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  /* CE2_N, MISO, MOSI, SCLK */
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[5], BCM2835_GPIO_FSEL_ALT4);
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[0], BCM2835_GPIO_FSEL_ALT4);
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[1], BCM2835_GPIO_FSEL_ALT4);
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[2], BCM2835_GPIO_FSEL_ALT4);
+  bcm2835_gpio_fsel_commit(&pins);
+
+  bcm2835_auxspi_setClockDivider(
+      spi, bcm2835_aux_spi_CalcClockDivider(1000000)); // Default 1MHz SPI
+
+  /* SPI1 and SPI2 share the enable register */
+  bcm2835_locked_set_bits(&bcm2835_aux_lock, enable, spi->enable,
+                          spi->enable);
+  bcm2835_auxspi_reset(spi);
 
   return 1; /* OK */
 }
 
-void bcm2835_aux_spi_end(void) {
-  /* Set all the SPI1 pins back to input */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_36, BCM2835_GPIO_FSEL_INPT); /* SPI1_CE2_N */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_35, BCM2835_GPIO_FSEL_INPT); /* SPI1_MISO */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_38, BCM2835_GPIO_FSEL_INPT); /* SPI1_MOSI */
-  bcm2835_gpio_fsel(RPI_V2_GPIO_P1_40, BCM2835_GPIO_FSEL_INPT); /* SPI1_SCLK */
+void bcm2835_auxspi_end(bcm2835AuxSPI *spi) {
+  /* Set all the SPI pins back to input */
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  /* CE2_N, MISO, MOSI, SCLK */
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[5], BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[0], BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[1], BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, spi->pins[2], BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_commit(&pins);
 }
 
 #define DIV_ROUND_UP(n, d) (((n) + (d)-1) / (d))
@@ -827,114 +1109,194 @@ uint16_t bcm2835_aux_spi_CalcClockDivider(uint32_t speed_hz) {
   return divider;
 }
 
-static uint32_t spi1_speed;
-
-void bcm2835_aux_spi_setClockDivider(uint16_t divider) {
-  spi1_speed = (uint32_t)divider;
+/* The divider is kept in position, so that the control words are only
+// ORed together per transfer
+*/
+void bcm2835_auxspi_setClockDivider(bcm2835AuxSPI *spi, uint16_t divider) {
+  spi->speed = Aux_cntl0_speed::val(divider);
 }
 
-void bcm2835_aux_spi_write(uint16_t data) {
-  volatile uint32_t *cntl0 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL0 / 4;
-  volatile uint32_t *cntl1 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL1 / 4;
-  volatile uint32_t *stat = bcm2835_spi1 + BCM2835_AUX_SPI_STAT / 4;
-  volatile uint32_t *io = bcm2835_spi1 + BCM2835_AUX_SPI_IO / 4;
+/* Selects CE0, CE1 or CE2. The pin is switched to ALT4 on first use.
+// BCM2835_SPI_CS_NONE keeps all three deasserted.
+*/
+void bcm2835_auxspi_chipSelect(bcm2835AuxSPI *spi, uint8_t cs) {
+  static const uint32_t cs_bits[] = {BCM2835_AUX_SPI_CNTL0_CS0_N,
+                                     BCM2835_AUX_SPI_CNTL0_CS1_N,
+                                     BCM2835_AUX_SPI_CNTL0_CS2_N};
 
-  uint32_t _cntl0 = (spi1_speed << BCM2835_AUX_SPI_CNTL0_SPEED_SHIFT);
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_CS2_N;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_ENABLE;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_MSBF_OUT;
-  _cntl0 |= 16; // Shift length
+  if (cs == BCM2835_SPI_CS_NONE) {
+    spi->cs = Aux_cntl0_cs::mask;
+    return;
+  }
 
-  bcm2835_peri_write(cntl0, _cntl0);
-  bcm2835_peri_write(cntl1, BCM2835_AUX_SPI_CNTL1_MSBF_IN);
+  if (cs > 2)
+    return;
 
-  while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_TX_FULL)
+  if (cs_bits[cs] != spi->cs)
+    bcm2835_gpio_fsel(spi->pins[3 + cs], BCM2835_GPIO_FSEL_ALT4);
+
+  spi->cs = cs_bits[cs];
+}
+
+void bcm2835_auxspi_write(bcm2835AuxSPI *spi, uint16_t data) {
+  volatile uint32_t *stat = spi->regs + BCM2835_AUX_SPI_STAT / 4;
+  volatile uint32_t *io = spi->regs + BCM2835_AUX_SPI_IO / 4;
+
+  bcm2835_auxspi_control(spi, Aux_cntl0_shiftlen::val(16),
+                         BCM2835_AUX_SPI_CNTL1_MSBF_IN);
+
+  while (bcm2835_peri_read_nb(stat) & BCM2835_AUX_SPI_STAT_TX_FULL)
     ;
 
+  /* Leave the peripheral with a barrier */
   bcm2835_peri_write(io, (uint32_t)data << 16);
 }
 
-void bcm2835_aux_spi_writenb(const char *tbuf, uint32_t len) {
-  volatile uint32_t *cntl0 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL0 / 4;
-  volatile uint32_t *cntl1 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL1 / 4;
-  volatile uint32_t *stat = bcm2835_spi1 + BCM2835_AUX_SPI_STAT / 4;
-  volatile uint32_t *txhold = bcm2835_spi1 + BCM2835_AUX_SPI_TXHOLD / 4;
-  volatile uint32_t *io = bcm2835_spi1 + BCM2835_AUX_SPI_IO / 4;
+/* Sleeps until the given CNTL1 interrupt condition holds. The enable bit
+// is dropped again before returning, which deasserts the level triggered
+// AUX interrupt.
+*/
+static void bcm2835_auxspi_sleep(bcm2835AuxSPI *spi, uint32_t event) {
+  volatile uint32_t *cntl1 = spi->regs + BCM2835_AUX_SPI_CNTL1 / 4;
 
-  char *tx = (char *)tbuf;
+  bcm2835_peri_write(cntl1, spi->cntl1 | event);
+  spi->wait(spi->wait_arg);
+  bcm2835_peri_write(cntl1, spi->cntl1);
+}
+
+/* Whether a transfer of len bytes sleeps instead of spinning. The
+// interrupt is bound to wait_thread and never reaches any other thread,
+// so transfers from other threads always spin.
+*/
+static int bcm2835_auxspi_may_sleep(const bcm2835AuxSPI *spi, uint32_t len) {
+  return spi->wait != NULL && len > BCM2835_AUX_SPI_IRQ_MIN &&
+         pthread_equal(spi->wait_thread, pthread_self());
+}
+
+/* Writes len bytes, keeping the TX FIFO filled through TXHOLD instead of
+// waiting for BUSY after every word. Received words are dropped as the RX
+// level reports them; at most one FIFO depth of words is outstanding so
+// that the RX FIFO cannot overflow.
+*/
+void bcm2835_auxspi_writenb(bcm2835AuxSPI *spi, const char *tbuf, uint32_t len) {
+  volatile uint32_t *stat = spi->regs + BCM2835_AUX_SPI_STAT / 4;
+  volatile uint32_t *txhold = spi->regs + BCM2835_AUX_SPI_TXHOLD / 4;
+  volatile uint32_t *io = spi->regs + BCM2835_AUX_SPI_IO / 4;
+
+  const uint8_t *tx = (const uint8_t *)tbuf;
   uint32_t tx_len = len;
+  uint32_t pending = 0;
   uint32_t count;
   uint32_t data;
-  uint32_t i;
-  uint8_t byte;
+  uint32_t status;
+  uint32_t rx_lvl;
+  int sleep = bcm2835_auxspi_may_sleep(spi, len);
 
-  uint32_t _cntl0 = (spi1_speed << BCM2835_AUX_SPI_CNTL0_SPEED_SHIFT);
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_CS2_N;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_ENABLE;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_MSBF_OUT;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_VAR_WIDTH;
+  bcm2835_auxspi_control(spi, BCM2835_AUX_SPI_CNTL0_VAR_WIDTH,
+                         BCM2835_AUX_SPI_CNTL1_MSBF_IN);
 
-  bcm2835_peri_write(cntl0, _cntl0);
-  bcm2835_peri_write(cntl1, BCM2835_AUX_SPI_CNTL1_MSBF_IN);
+  while (tx_len > 0 || pending > 0) {
+    status = bcm2835_peri_read_nb(stat);
 
-  while (tx_len > 0) {
+    /* Drop whatever has been received so far */
+    rx_lvl = (status & BCM2835_AUX_SPI_STAT_RX_LVL) >>
+             BCM2835_AUX_SPI_STAT_RX_LVL_SHIFT;
+    for (; rx_lvl > 0 && pending > 0; rx_lvl--, pending--)
+      (void)bcm2835_peri_read_nb(io);
 
-    while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_TX_FULL)
-      ;
+    /* Top up the TX FIFO, 24 bits per variable width word */
+    while (tx_len > 0 && pending < BCM2835_AUX_SPI_FIFO_DEPTH) {
+      count = MIN(tx_len, 3);
+      data = (count * 8) << 24;
 
-    count = MIN(tx_len, 3);
-    data = 0;
+      if (tx != NULL) {
+        switch (count) {
+        case 3:
+          data |= (uint32_t)tx[2];
+          /*@fallthrough@*/
+          /* no break */
+        case 2:
+          data |= (uint32_t)tx[1] << 8;
+          /*@fallthrough@*/
+          /* no break */
+        case 1:
+          data |= (uint32_t)tx[0] << 16;
+        }
+        tx += count;
+      }
+      tx_len -= count;
 
-    for (i = 0; i < count; i++) {
-      byte = (tx != NULL) ? (uint8_t)*tx++ : (uint8_t)0;
-      data |= byte << (8 * (2 - i));
+      if (tx_len != 0)
+        bcm2835_peri_write_nb(txhold, data);
+      else
+        bcm2835_peri_write_nb(io, data);
+      pending++;
     }
 
-    data |= (count * 8) << 24;
-    tx_len -= count;
+    /* With a full pipeline nothing happens until the TX FIFO drains */
+    if (sleep && pending == BCM2835_AUX_SPI_FIFO_DEPTH)
+      bcm2835_auxspi_sleep(spi, BCM2835_AUX_SPI_CNTL1_TXEMPTY);
+    else if (sleep && tx_len == 0 && pending > 0)
+      bcm2835_auxspi_sleep(spi, BCM2835_AUX_SPI_CNTL1_IDLE);
+  }
 
-    if (tx_len != 0) {
-      bcm2835_peri_write(txhold, data);
-    } else {
-      bcm2835_peri_write(io, data);
-    }
+  /* Leave the peripheral with a barrier */
+  (void)bcm2835_peri_read(stat);
+}
 
-    while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_BUSY)
-      ;
+/* Starts an AUX SPI transfer in variable width mode */
+void bcm2835_auxspi_transfer_begin(bcm2835AuxSPI *spi) {
+  bcm2835_auxspi_control(spi, BCM2835_AUX_SPI_CNTL0_VAR_WIDTH,
+                         BCM2835_AUX_SPI_CNTL1_MSBF_IN);
+}
 
-    (void)bcm2835_peri_read(io);
+/* Stores up to 3 received bytes of an RX FIFO word */
+static char *bcm2835_auxspi_unpack(char *rx, uint32_t data, uint32_t count) {
+  if (rx == NULL)
+    return NULL;
+
+  switch (count) {
+  case 3:
+    *rx++ = (char)((data >> 16) & 0xFF);
+    /*@fallthrough@*/
+    /* no break */
+  case 2:
+    *rx++ = (char)((data >> 8) & 0xFF);
+    /*@fallthrough@*/
+    /* no break */
+  case 1:
+    *rx++ = (char)((data >> 0) & 0xFF);
   }
+  return rx;
 }
 
-void bcm2835_aux_spi_transfernb(const char *tbuf, char *rbuf, uint32_t len) {
-  volatile uint32_t *cntl0 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL0 / 4;
-  volatile uint32_t *cntl1 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL1 / 4;
-  volatile uint32_t *stat = bcm2835_spi1 + BCM2835_AUX_SPI_STAT / 4;
-  volatile uint32_t *txhold = bcm2835_spi1 + BCM2835_AUX_SPI_TXHOLD / 4;
-  volatile uint32_t *io = bcm2835_spi1 + BCM2835_AUX_SPI_IO / 4;
+/* Transfers len bytes within a started AUX SPI transfer. All words go
+// through TXHOLD and keep CS asserted, except for the final word of the
+// last segment, which goes through IO and releases CS. Long transfers on a
+// controller with a wait function sleep while the FIFOs are busy. At most
+// one FIFO depth of words is outstanding, so that the RX FIFO cannot
+// overflow however late the sleeper wakes up.
+*/
+void bcm2835_auxspi_transfer_continue(bcm2835AuxSPI *spi, const char *tbuf,
+                                      char *rbuf, uint32_t len, int last) {
+  volatile uint32_t *stat = spi->regs + BCM2835_AUX_SPI_STAT / 4;
+  volatile uint32_t *txhold = spi->regs + BCM2835_AUX_SPI_TXHOLD / 4;
+  volatile uint32_t *io = spi->regs + BCM2835_AUX_SPI_IO / 4;
 
   char *tx = (char *)tbuf;
   char *rx = (char *)rbuf;
   uint32_t tx_len = len;
   uint32_t rx_len = len;
+  uint32_t pending = 0;
   uint32_t count;
   uint32_t data;
   uint32_t i;
   uint8_t byte;
-
-  uint32_t _cntl0 = (spi1_speed << BCM2835_AUX_SPI_CNTL0_SPEED_SHIFT);
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_CS2_N;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_ENABLE;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_MSBF_OUT;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_VAR_WIDTH;
-
-  bcm2835_peri_write(cntl0, _cntl0);
-  bcm2835_peri_write(cntl1, BCM2835_AUX_SPI_CNTL1_MSBF_IN);
+  int sleep = bcm2835_auxspi_may_sleep(spi, len);
 
   while ((tx_len > 0) || (rx_len > 0)) {
 
-    while (!(bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_TX_FULL) &&
-           (tx_len > 0)) {
+    while ((tx_len > 0) && (pending < BCM2835_AUX_SPI_FIFO_DEPTH)) {
       count = MIN(tx_len, 3);
       data = 0;
 
@@ -946,97 +1308,317 @@ void bcm2835_aux_spi_transfernb(const char *tbuf, char *rbuf, uint32_t len) {
       data |= (count * 8) << 24;
       tx_len -= count;
 
-      if (tx_len != 0) {
-        bcm2835_peri_write(txhold, data);
+      if (tx_len != 0 || !last) {
+        bcm2835_peri_write_nb(txhold, data);
       } else {
-        bcm2835_peri_write(io, data);
+        bcm2835_peri_write_nb(io, data);
       }
+      pending++;
     }
 
-    while (!(bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_RX_EMPTY) &&
-           (rx_len > 0)) {
+    while (!(bcm2835_peri_read_nb(stat) & BCM2835_AUX_SPI_STAT_RX_EMPTY) &&
+           (pending > 0)) {
       count = MIN(rx_len, 3);
-      data = bcm2835_peri_read(io);
-
-      if (rbuf != NULL) {
-        switch (count) {
-        case 3:
-          *rx++ = (char)((data >> 16) & 0xFF);
-          /*@fallthrough@*/
-          /* no break */
-        case 2:
-          *rx++ = (char)((data >> 8) & 0xFF);
-          /*@fallthrough@*/
-          /* no break */
-        case 1:
-          *rx++ = (char)((data >> 0) & 0xFF);
-        }
-      }
-
+      data = bcm2835_peri_read_nb(io);
+      rx = bcm2835_auxspi_unpack(rx, data, count);
       rx_len -= count;
+      pending--;
     }
 
-    while (!(bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_BUSY) &&
-           (rx_len > 0)) {
-      count = MIN(rx_len, 3);
-      data = bcm2835_peri_read(io);
+    /* Nothing to do until the FIFOs move. Wait for the TX FIFO to drain
+    // while the pipeline is full, for the shifter to go idle at the end.
+    */
+    if (sleep && (pending == BCM2835_AUX_SPI_FIFO_DEPTH ||
+                  (tx_len == 0 && pending > 0))
+        && (bcm2835_peri_read_nb(stat) & BCM2835_AUX_SPI_STAT_RX_EMPTY))
+      bcm2835_auxspi_sleep(spi, tx_len > 0 ? BCM2835_AUX_SPI_CNTL1_TXEMPTY
+                                           : BCM2835_AUX_SPI_CNTL1_IDLE);
+  }
 
-      if (rbuf != NULL) {
-        switch (count) {
-        case 3:
-          *rx++ = (char)((data >> 16) & 0xFF);
-          /*@fallthrough@*/
-          /* no break */
-        case 2:
-          *rx++ = (char)((data >> 8) & 0xFF);
-          /*@fallthrough@*/
-          /* no break */
-        case 1:
-          *rx++ = (char)((data >> 0) & 0xFF);
-        }
-      }
+  /* Leave the peripheral with a barrier */
+  bcm2835_memory_barrier();
+}
 
-      rx_len -= count;
-    }
-  }
+/* Ends an AUX SPI transfer whose last segment did not release CS */
+void bcm2835_auxspi_transfer_end(bcm2835AuxSPI *spi) {
+  bcm2835_auxspi_reset(spi);
+}
+
+void bcm2835_auxspi_transfernb(bcm2835AuxSPI *spi, const char *tbuf,
+                               char *rbuf, uint32_t len) {
+  bcm2835_auxspi_transfer_begin(spi);
+  bcm2835_auxspi_transfer_continue(spi, tbuf, rbuf, len, 1);
+}
+
+/* Writes (and reads) a single byte to AUX SPI */
+/* The RX FIFO is drained before returning, so no reset is needed between
+// bytes and the control words stay cached for the next call.
+*/
+uint8_t bcm2835_auxspi_transfer(bcm2835AuxSPI *spi, uint8_t value) {
+  volatile uint32_t *stat = spi->regs + BCM2835_AUX_SPI_STAT / 4;
+  volatile uint32_t *io = spi->regs + BCM2835_AUX_SPI_IO / 4;
+
+  uint32_t data;
+
+  bcm2835_auxspi_control(
+      spi, BCM2835_AUX_SPI_CNTL0_CPHA_IN | Aux_cntl0_shiftlen::val(8),
+      BCM2835_AUX_SPI_CNTL1_MSBF_IN);
+
+  bcm2835_peri_write_nb(io, (uint32_t)bcm2835_correct_order(value) << 24);
+
+  while (bcm2835_peri_read_nb(stat) & BCM2835_AUX_SPI_STAT_BUSY)
+    ;
+
+  /* Leave the peripheral with a barrier */
+  data = bcm2835_correct_order(bcm2835_peri_read(io) & 0xff);
+
+  return data;
+}
+
+/* SPI1 interface, kept for compatibility */
+int bcm2835_aux_spi_begin(void) {
+  return bcm2835_auxspi_begin(&bcm2835_aux_spi1_ctrl);
+}
+
+void bcm2835_aux_spi_end(void) { bcm2835_auxspi_end(&bcm2835_aux_spi1_ctrl); }
+
+void bcm2835_aux_spi_setClockDivider(uint16_t divider) {
+  bcm2835_auxspi_setClockDivider(&bcm2835_aux_spi1_ctrl, divider);
+}
+
+void bcm2835_aux_spi_chipSelect(uint8_t cs) {
+  bcm2835_auxspi_chipSelect(&bcm2835_aux_spi1_ctrl, cs);
+}
+
+void bcm2835_aux_spi_write(uint16_t data) {
+  bcm2835_auxspi_write(&bcm2835_aux_spi1_ctrl, data);
+}
+
+void bcm2835_aux_spi_writenb(const char *tbuf, uint32_t len) {
+  bcm2835_auxspi_writenb(&bcm2835_aux_spi1_ctrl, tbuf, len);
+}
+
+void bcm2835_aux_spi_transfer_begin(void) {
+  bcm2835_auxspi_transfer_begin(&bcm2835_aux_spi1_ctrl);
+}
+
+void bcm2835_aux_spi_transfer_continue(const char *tbuf, char *rbuf,
+                                       uint32_t len, int last) {
+  bcm2835_auxspi_transfer_continue(&bcm2835_aux_spi1_ctrl, tbuf, rbuf, len,
+                                   last);
+}
+
+void bcm2835_aux_spi_transfer_end(void) {
+  bcm2835_auxspi_transfer_end(&bcm2835_aux_spi1_ctrl);
+}
+
+void bcm2835_aux_spi_transfernb(const char *tbuf, char *rbuf, uint32_t len) {
+  bcm2835_auxspi_transfernb(&bcm2835_aux_spi1_ctrl, tbuf, rbuf, len);
 }
 
 void bcm2835_aux_spi_transfern(char *buf, uint32_t len) {
   bcm2835_aux_spi_transfernb(buf, buf, len);
 }
 
-/* Writes (and reads) a single byte to AUX SPI */
 uint8_t bcm2835_aux_spi_transfer(uint8_t value) {
-  volatile uint32_t *cntl0 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL0 / 4;
-  volatile uint32_t *cntl1 = bcm2835_spi1 + BCM2835_AUX_SPI_CNTL1 / 4;
-  volatile uint32_t *stat = bcm2835_spi1 + BCM2835_AUX_SPI_STAT / 4;
-  volatile uint32_t *io = bcm2835_spi1 + BCM2835_AUX_SPI_IO / 4;
+  return bcm2835_auxspi_transfer(&bcm2835_aux_spi1_ctrl, value);
+}
 
-  uint32_t data;
+/* The BSC controllers. Pins are SDA, SCL. */
+bcm2835BSC bcm2835_bsc0_ctrl = {NULL, {0, 1}, NULL, NULL};
+bcm2835BSC bcm2835_bsc1_ctrl = {NULL, {2, 3}, NULL, NULL};
 
-  uint32_t _cntl0 = (spi1_speed << BCM2835_AUX_SPI_CNTL0_SPEED_SHIFT);
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_CS2_N;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_ENABLE;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_MSBF_OUT;
-  _cntl0 |= BCM2835_AUX_SPI_CNTL0_CPHA_IN;
-  _cntl0 |= 8; // Shift length.
+int bcm2835_bsc_begin(bcm2835BSC *bsc) {
+  if (bsc->regs == MAP_FAILED || bsc->regs == NULL)
+    return 0; /* bcm2835_init() failed, or the controller is not mapped */
 
-  uint32_t _cntl1 = BCM2835_AUX_SPI_CNTL1_MSBF_IN;
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  /* SDA, SCL */
+  bcm2835_gpio_fsel_stage(&pins, bsc->pins[0], BCM2835_GPIO_FSEL_ALT0);
+  bcm2835_gpio_fsel_stage(&pins, bsc->pins[1], BCM2835_GPIO_FSEL_ALT0);
+  bcm2835_gpio_fsel_commit(&pins);
 
-  bcm2835_peri_write(cntl1, _cntl1);
-  bcm2835_peri_write(cntl0, _cntl0);
+  bcm2835_bsc_set_baudrate(bsc, 100000);
+  return 1;
+}
+
+void bcm2835_bsc_end(bcm2835BSC *bsc) {
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  /* SDA, SCL */
+  bcm2835_gpio_fsel_stage(&pins, bsc->pins[0], BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_stage(&pins, bsc->pins[1], BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_commit(&pins);
+}
 
-  bcm2835_peri_write(io, (uint32_t)bcm2835_correct_order(value) << 24);
+void bcm2835_bsc_set_baudrate(bcm2835BSC *bsc, uint32_t baudrate) {
+  volatile uint32_t *paddr = bsc->regs + BCM2835_BSC_DIV / 4;
+  uint32_t divider;
 
-  while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_BUSY)
+  if (baudrate == 0)
+    return;
+
+  /* The divider is always rounded down to an even number */
+  divider = (BCM2835_CORE_CLK_HZ / baudrate) & 0xFFFE;
+  bcm2835_peri_write(paddr, divider);
+}
+
+/* Waits for one of the status conditions in stat_mask. With a wait
+// function the matching interrupts are enabled for the wait only; C is
+// rewritten without ST, so the running transfer is not restarted.
+*/
+static uint32_t bcm2835_bsc_wait(bcm2835BSC *bsc, uint32_t control,
+                                 uint32_t stat_mask, uint32_t irqs) {
+  volatile uint32_t *c = bsc->regs + BCM2835_BSC_C / 4;
+  volatile uint32_t *s = bsc->regs + BCM2835_BSC_S / 4;
+  uint32_t status = bcm2835_peri_read_nb(s);
+
+  if (status & stat_mask)
+    return status;
+
+  if (bsc->wait) {
+    bcm2835_peri_write(c, control | irqs);
+    bsc->wait(bsc->wait_arg);
+    bcm2835_peri_write(c, control);
+    return bcm2835_peri_read(s);
+  }
+
+  while (!((status = bcm2835_peri_read_nb(s)) & stat_mask))
     ;
+  return status;
+}
 
-  data = bcm2835_correct_order(bcm2835_peri_read(io) & 0xff);
+/* Feeds the TX FIFO until the write is complete */
+static uint32_t bcm2835_bsc_fill(bcm2835BSC *bsc, const char *wbuf,
+                                 uint32_t wlen, uint32_t *sent) {
+  volatile uint32_t *s = bsc->regs + BCM2835_BSC_S / 4;
+  volatile uint32_t *fifo = bsc->regs + BCM2835_BSC_FIFO / 4;
+  uint32_t n = *sent;
 
-  bcm2835_aux_spi_reset();
+  while (n < wlen && (bcm2835_peri_read_nb(s) & BCM2835_BSC_S_TXD))
+    bcm2835_peri_write_nb(fifo, (uint8_t)wbuf[n++]);
 
-  return data;
+  *sent = n;
+  return bcm2835_peri_read_nb(s);
+}
+
+/* Drains the RX FIFO */
+static uint32_t bcm2835_bsc_drain(bcm2835BSC *bsc, char *rbuf, uint32_t rlen,
+                                  uint32_t *received) {
+  volatile uint32_t *s = bsc->regs + BCM2835_BSC_S / 4;
+  volatile uint32_t *fifo = bsc->regs + BCM2835_BSC_FIFO / 4;
+  uint32_t n = *received;
+
+  while (n < rlen && (bcm2835_peri_read_nb(s) & BCM2835_BSC_S_RXD))
+    rbuf[n++] = (char)bcm2835_peri_read_nb(fifo);
+
+  *received = n;
+  return bcm2835_peri_read_nb(s);
+}
+
+static uint8_t bcm2835_bsc_reason(uint32_t status, uint32_t done,
+                                  uint32_t len) {
+  if (status & BCM2835_BSC_S_ERR)
+    return BCM2835_I2C_REASON_ERROR_NACK;
+  if (status & BCM2835_BSC_S_CLKT)
+    return BCM2835_I2C_REASON_ERROR_CLKT;
+  if (done < len)
+    return BCM2835_I2C_REASON_ERROR_DATA;
+  return BCM2835_I2C_REASON_OK;
+}
+
+/* Combined write and read. The FIFO is filled before the transfer starts,
+// so short writes go out as one burst; longer writes and reads are fed and
+// drained as the FIFO thresholds are reached.
+*/
+uint8_t bcm2835_bsc_write_read(bcm2835BSC *bsc, uint8_t addr,
+                               const char *wbuf, uint32_t wlen, char *rbuf,
+                               uint32_t rlen) {
+  volatile uint32_t *c = bsc->regs + BCM2835_BSC_C / 4;
+  volatile uint32_t *s = bsc->regs + BCM2835_BSC_S / 4;
+  volatile uint32_t *dlen = bsc->regs + BCM2835_BSC_DLEN / 4;
+  volatile uint32_t *a = bsc->regs + BCM2835_BSC_A / 4;
+  const uint32_t clear =
+      BCM2835_BSC_S_CLKT | BCM2835_BSC_S_ERR | BCM2835_BSC_S_DONE;
+  uint32_t sent = 0;
+  uint32_t received = 0;
+  uint32_t status;
+  uint8_t reason = BCM2835_I2C_REASON_OK;
+  int restart = wlen > 0 && rlen > 0 && wlen <= BCM2835_BSC_FIFO_SIZE;
+
+  bcm2835_peri_write(a, addr);
+  bcm2835_peri_write(c, BCM2835_BSC_C_CLEAR_1);
+  bcm2835_peri_write(s, clear);
+
+  if (wlen > 0) {
+    bcm2835_peri_write(dlen, wlen);
+    bcm2835_bsc_fill(bsc, wbuf, wlen, &sent);
+    bcm2835_peri_write(c, BCM2835_BSC_C_I2CEN | BCM2835_BSC_C_ST);
+
+    if (restart) {
+      /* Queue the read while the write is active; the controller then
+      // follows the write with a repeated start instead of a stop. A NACK
+      // or clock stretch timeout ends the wait like every other one.
+      */
+      while (!((status = bcm2835_peri_read_nb(s)) &
+               (BCM2835_BSC_S_TA | BCM2835_BSC_S_DONE | BCM2835_BSC_S_ERR |
+                BCM2835_BSC_S_CLKT)))
+        ;
+      if (status & (BCM2835_BSC_S_ERR | BCM2835_BSC_S_CLKT)) {
+        reason = bcm2835_bsc_reason(status, sent, wlen);
+        bcm2835_peri_write(s, clear);
+        return reason;
+      }
+      bcm2835_peri_write_nb(dlen, rlen);
+      bcm2835_peri_write_nb(c, BCM2835_BSC_C_I2CEN | BCM2835_BSC_C_ST |
+                                   BCM2835_BSC_C_READ);
+    } else {
+      for (;;) {
+        status = bcm2835_bsc_fill(bsc, wbuf, wlen, &sent);
+        if (status & BCM2835_BSC_S_DONE)
+          break;
+        if (sent < wlen)
+          bcm2835_bsc_wait(bsc, BCM2835_BSC_C_I2CEN,
+                           BCM2835_BSC_S_TXW | BCM2835_BSC_S_DONE,
+                           BCM2835_BSC_C_INTT | BCM2835_BSC_C_INTD);
+        else
+          bcm2835_bsc_wait(bsc, BCM2835_BSC_C_I2CEN, BCM2835_BSC_S_DONE,
+                           BCM2835_BSC_C_INTD);
+      }
+
+      reason = bcm2835_bsc_reason(status, sent, wlen);
+      bcm2835_peri_write(s, clear);
+      if (reason != BCM2835_I2C_REASON_OK || rlen == 0)
+        return reason;
+
+      bcm2835_peri_write(dlen, rlen);
+      bcm2835_peri_write(c, BCM2835_BSC_C_I2CEN | BCM2835_BSC_C_ST |
+                                BCM2835_BSC_C_READ);
+    }
+  } else if (rlen > 0) {
+    bcm2835_peri_write(dlen, rlen);
+    bcm2835_peri_write(c, BCM2835_BSC_C_I2CEN | BCM2835_BSC_C_ST |
+                              BCM2835_BSC_C_READ);
+  } else {
+    return BCM2835_I2C_REASON_OK;
+  }
+
+  for (;;) {
+    status = bcm2835_bsc_drain(bsc, rbuf, rlen, &received);
+    if (status & BCM2835_BSC_S_DONE)
+      break;
+    bcm2835_bsc_wait(bsc, BCM2835_BSC_C_I2CEN | BCM2835_BSC_C_READ,
+                     BCM2835_BSC_S_RXR | BCM2835_BSC_S_DONE,
+                     BCM2835_BSC_C_INTR | BCM2835_BSC_C_INTD);
+  }
+
+  /* Collect what arrived together with DONE */
+  status = bcm2835_bsc_drain(bsc, rbuf, rlen, &received) | status;
+
+  reason = bcm2835_bsc_reason(status, received, rlen);
+  bcm2835_peri_write(s, clear);
+  return reason;
 }
+
 uint64_t bcm2835_st_read(void) {
   volatile uint32_t *paddr;
   uint32_t hi, lo;
@@ -1045,14 +1627,15 @@ uint64_t bcm2835_st_read(void) {
   if (bcm2835_st == MAP_FAILED)
     return 0;
 
+  /* Only entering and leaving the timer need a barrier */
   paddr = bcm2835_st + BCM2835_ST_CHI / 4;
   hi = bcm2835_peri_read(paddr);
 
   paddr = bcm2835_st + BCM2835_ST_CLO / 4;
-  lo = bcm2835_peri_read(paddr);
+  lo = bcm2835_peri_read_nb(paddr);
 
   paddr = bcm2835_st + BCM2835_ST_CHI / 4;
-  st = bcm2835_peri_read(paddr);
+  st = bcm2835_peri_read_nb(paddr);
 
   /* Test for overflow */
   if (st == hi) {
@@ -1061,15 +1644,93 @@ uint64_t bcm2835_st_read(void) {
   } else {
     st <<= 32;
     paddr = bcm2835_st + BCM2835_ST_CLO / 4;
-    st += bcm2835_peri_read(paddr);
+    st += bcm2835_peri_read_nb(paddr);
   }
+  bcm2835_memory_barrier();
   return st;
 }
 
-/* Delays for the specified number of microseconds with offset */
+#if defined(__aarch64__)
+/* The virtual count of the generic timer. The ISB keeps the read from
+// being hoisted above the code that is being timed.
+*/
+static inline uint64_t bcm2835_cntvct(void) {
+  uint64_t ticks;
+
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks)::"memory");
+  return ticks;
+}
+#endif
+
+/* Picks the time base of bcm2835_nanos(). The generic timer is read
+// without leaving the core; the System Timer costs several uncached reads
+// and the KIP clock only has the resolution of the kernel tick.
+*/
+uint8_t bcm2835_clock_init(void) {
+#if defined(__aarch64__)
+  uint64_t hz;
+
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(hz));
+  if (hz) {
+    bcm2835_cntvct_mult = ((uint64_t)1000000000 << 32) / hz;
+    bcm2835_clock = BCM2835_CLOCK_GENERIC;
+    return bcm2835_clock;
+  }
+#endif
+
+  if (bcm2835_st != MAP_FAILED)
+    bcm2835_clock = BCM2835_CLOCK_ST;
+  else
+    bcm2835_clock = BCM2835_CLOCK_KIP;
+  return bcm2835_clock;
+}
+
+/* Nanosecond time base of all delays, timeouts and timestamps */
+uint64_t bcm2835_nanos(void) {
+  switch (bcm2835_clock) {
+#if defined(__aarch64__)
+  case BCM2835_CLOCK_GENERIC:
+    return (uint64_t)(((unsigned __int128)bcm2835_cntvct() *
+                       bcm2835_cntvct_mult) >> 32);
+#endif
+  case BCM2835_CLOCK_ST:
+    return bcm2835_st_read() * 1000;
+  default:
+    return l4_kip_clock(l4re_kip()) * 1000;
+  }
+}
+
+/* Microsecond time base, see bcm2835_nanos() */
+uint64_t bcm2835_micros(void) { return bcm2835_nanos() / 1000; }
+
+/* Busy waits for the specified number of nanoseconds */
+void bcm2835_delayNanoseconds(uint64_t nanos) {
+  uint64_t start = bcm2835_nanos();
+
+  while (bcm2835_nanos() - start < nanos)
+    ;
+}
+
+/* Busy waits until bcm2835_micros() reaches the given time */
+void bcm2835_delayUntil(uint64_t micros) {
+  uint64_t compare = micros * 1000;
+
+  while (bcm2835_nanos() < compare)
+    ;
+}
+
+/* Delays for the specified number of microseconds with offset, on the
+// System Timer. Without it the wait falls back to bcm2835_micros(), so it
+// still terminates.
+*/
 void bcm2835_st_delay(uint64_t offset_micros, uint64_t micros) {
   uint64_t compare = offset_micros + micros;
 
+  if (bcm2835_st == MAP_FAILED) {
+    bcm2835_delayUntil(compare);
+    return;
+  }
+
   while (bcm2835_st_read() < compare)
     ;
 }
@@ -1077,16 +1738,28 @@ void bcm2835_st_delay(uint64_t offset_micros, uint64_t micros) {
 /* Initialise this library. */
 int bcm2835_init(void) {
 
-  // here the offset into the dataspace
-  bcm2835_peripherals = 0;
+  /* The block bases were filled in by bcm2835_map_peripherals(); blocks
+  // that could not be attached stay MAP_FAILED so that their users fall
+  // back instead of faulting. The AUX SPI controllers share the AUX page.
+  */
+  if (bcm2835_gpio == MAP_FAILED || bcm2835_spi0 == MAP_FAILED)
+    return 0;
+
+  for (int i = 0; i < BCM2835_GPFSEL_COUNT; i++)
+    bcm2835_fsel_shadow[i] =
+        bcm2835_peri_read(bcm2835_gpio + BCM2835_GPFSEL0 / 4 + i);
+
+  if (bcm2835_aux != MAP_FAILED) {
+    bcm2835_spi1 = bcm2835_aux + (BCM2835_SPI1_BASE - BCM2835_AUX_BASE) / 4;
+    bcm2835_spi2 = bcm2835_aux + (BCM2835_SPI2_BASE - BCM2835_AUX_BASE) / 4;
+  }
+
+  bcm2835_clock_init();
 
-  bcm2835_pads = bcm2835_peripherals + BCM2835_GPIO_PADS / 4;
-  bcm2835_clk = bcm2835_peripherals + BCM2835_CLOCK_BASE / 4;
-  bcm2835_gpio = bcm2835_peripherals + BCM2835_GPIO_BASE / 4;
-  bcm2835_spi0 = bcm2835_peripherals + BCM2835_SPI0_BASE / 4;
-  bcm2835_st = bcm2835_peripherals + BCM2835_ST_BASE / 4;
-  bcm2835_aux = bcm2835_peripherals + BCM2835_AUX_BASE / 4;
-  bcm2835_spi1 = bcm2835_peripherals + BCM2835_SPI1_BASE / 4;
+  bcm2835_aux_spi1_ctrl.regs = bcm2835_spi1;
+  bcm2835_aux_spi2_ctrl.regs = bcm2835_spi2;
+  bcm2835_bsc0_ctrl.regs = bcm2835_bsc0;
+  bcm2835_bsc1_ctrl.regs = bcm2835_bsc1;
 
   return 1; /* Success */
 }
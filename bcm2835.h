@@ -620,6 +620,7 @@
 #ifndef BCM2835_H
 #define BCM2835_H
 
+#include <pthread.h>
 #include <stdint.h>
 
 /* Some compilers need this, as reported by Sam James */
@@ -708,6 +709,15 @@
 /*! Base Address of the BSC1 registers */
 #define BCM2835_BSC1_BASE				0x804000
 
+/*! Interrupt number of the GPIO bank 0 (pins 0 to 31) on the vbus */
+#define BCM2835_IRQ_GPIO0				49
+/*! Interrupt number of SPI0 on the vbus */
+#define BCM2835_IRQ_SPI					54
+/*! Interrupt number of the AUX block (UART1, SPI1 and SPI2) on the vbus */
+#define BCM2835_IRQ_AUX					29
+/*! Interrupt number of the BSC controllers on the vbus */
+#define BCM2835_IRQ_I2C					53
+
 #include <stdlib.h>
 
 /*! Physical address and size of the peripherals block
@@ -770,6 +780,11 @@ extern volatile uint32_t *bcm2835_aux;
 */
 extern volatile uint32_t *bcm2835_spi1;
 
+/*! Base of the SPI2 registers.
+  Available after bcm2835_init has been called (as root)
+*/
+extern volatile uint32_t *bcm2835_spi2;
+
 
 /*! \brief bcm2835RegisterBase
   Register bases for bcm2835_regbase()
@@ -785,9 +800,20 @@ typedef enum
     BCM2835_REGBASE_BSC0 = 7, /*!< Base of the BSC0 registers. */
     BCM2835_REGBASE_BSC1 = 8,  /*!< Base of the BSC1 registers. */
 	BCM2835_REGBASE_AUX  = 9,  /*!< Base of the AUX registers. */
-	BCM2835_REGBASE_SPI1 = 10  /*!< Base of the SPI1 registers. */
+	BCM2835_REGBASE_SPI1 = 10, /*!< Base of the SPI1 registers. */
+	BCM2835_REGBASE_SPI2 = 11  /*!< Base of the SPI2 registers. */
 } bcm2835RegisterBase;
 
+/*! \brief bcm2835ClockSource
+  Time bases of bcm2835_nanos(), see bcm2835_clock_init()
+*/
+typedef enum
+{
+    BCM2835_CLOCK_GENERIC = 0, /*!< AArch64 generic timer, CNTVCT_EL0 */
+    BCM2835_CLOCK_ST      = 1, /*!< System Timer, 1 MHz over MMIO */
+    BCM2835_CLOCK_KIP     = 2  /*!< Kernel clock from the KIP */
+} bcm2835ClockSource;
+
 /*! Size of memory page on RPi */
 #define BCM2835_PAGE_SIZE               (4*1024)
 /*! Size of memory block on RPi */
@@ -853,6 +879,22 @@ typedef enum
     BCM2835_GPIO_FSEL_MASK  = 0x07    /*!< Function select bits mask 0b111 */
 } bcm2835FunctionSelect;
 
+/*! Number of GPFSEL registers */
+#define BCM2835_GPFSEL_COUNT 6
+
+/*! \brief bcm2835FselBatch
+  Function select changes collected by bcm2835_gpio_fsel_stage() and written by
+  bcm2835_gpio_fsel_commit(). Initialise with BCM2835_FSEL_BATCH_INIT.
+*/
+typedef struct
+{
+    uint32_t value[BCM2835_GPFSEL_COUNT]; /*!< New function bits per GPFSEL register */
+    uint32_t mask[BCM2835_GPFSEL_COUNT];  /*!< Changed function bits per GPFSEL register */
+} bcm2835FselBatch;
+
+/*! Empty bcm2835FselBatch */
+#define BCM2835_FSEL_BATCH_INIT {{0}, {0}}
+
 /*! \brief bcm2835PUDControl
   Pullup/Pulldown defines for bcm2835_gpio_pud()
 */
@@ -1046,6 +1088,39 @@ typedef enum
 #define BCM2835_AUX_SPI_STAT_RX_EMPTY	0x00000080  /*!< */
 #define BCM2835_AUX_SPI_STAT_BUSY	0x00000040  /*!< */
 #define BCM2835_AUX_SPI_STAT_BITCOUNT	0x0000003F  /*!< */
+#define BCM2835_AUX_SPI_STAT_TX_LVL_SHIFT 28        /*!< */
+#define BCM2835_AUX_SPI_STAT_RX_LVL_SHIFT 20        /*!< */
+
+#define BCM2835_AUX_SPI_FIFO_DEPTH	4           /*!< Entries in each of the TX and RX FIFOs */
+#define BCM2835_AUX_SPI_IRQ_MIN		(BCM2835_AUX_SPI_FIFO_DEPTH * 3) /*!< Transfers up to this length in bytes always spin */
+
+/*! \brief bcm2835AuxSPI
+  State of one AUX SPI controller, passed to the bcm2835_auxspi_* functions.
+  SPI1 and SPI2 share one implementation and differ only in this state.
+  When wait is set, transfers longer than BCM2835_AUX_SPI_IRQ_MIN sleep in it
+  with the TX empty or idle interrupt enabled instead of spinning on STAT.
+  Only wait_thread receives the interrupt, transfers from other threads spin.
+  SPI1, SPI2 and UART1 share one interrupt line, so at most one controller
+  should be given a wait function.
+*/
+typedef struct
+{
+    volatile uint32_t *regs;  /*!< Register base, set by bcm2835_init() */
+    uint32_t enable;          /*!< Bit in BCM2835_AUX_ENABLE */
+    uint32_t speed;           /*!< Clock divider, in the SPEED field of CNTL0 */
+    uint32_t cs;              /*!< Chip select bits of CNTL0 */
+    uint8_t pins[6];          /*!< GPIOs of MISO, MOSI, SCLK, CE0, CE1 and CE2 */
+    uint32_t cntl0;           /*!< Last value written to CNTL0 */
+    uint32_t cntl1;           /*!< Last value written to CNTL1 */
+    void (*wait)(void *arg);  /*!< Blocks until the AUX interrupt fires, NULL to spin */
+    void *wait_arg;           /*!< Argument passed to wait */
+    pthread_t wait_thread;    /*!< The only thread that may call wait */
+} bcm2835AuxSPI;
+
+/*! The AUX SPI1 controller */
+extern bcm2835AuxSPI bcm2835_aux_spi1_ctrl;
+/*! The AUX SPI2 controller */
+extern bcm2835AuxSPI bcm2835_aux_spi2_ctrl;
 
 /* Defines for SPI
    GPIO register offsets from BCM2835_SPI0_BASE. 
@@ -1086,6 +1161,9 @@ typedef enum
 #define BCM2835_SPI0_CS_CPHA                 0x00000004 /*!< Clock Phase */
 #define BCM2835_SPI0_CS_CS                   0x00000003 /*!< Chip Select */
 
+#define BCM2835_SPI_LOSSI_DATA               0x0100 /*!< Bit 8 of a LoSSI word, set for data and clear for commands */
+#define BCM2835_SPI_LOSSI_PARAMS_MAX         64     /*!< Parameters per bcm2835_spi_lossi_command() */
+
 /*! \brief bcm2835SPIBitOrder SPI Bit order
   Specifies the SPI data bit ordering for bcm2835_spi_setBitOrder()
 */
@@ -1152,6 +1230,84 @@ typedef enum
     BCM2835_SPI_CLOCK_DIVIDER_1     = 1        /*!< 1 = 3.814697260kHz on Rpi2, 6.1035156kHz on RPI3, same as 0/65536 */
 } bcm2835SPIClockDivider;
 
+/* Defines for I2C
+   GPIO register offsets from BCM2835_BSC*_BASE.
+   Offsets into the BSC Peripheral block in bytes per 3.1 BSC Register Map
+*/
+#define BCM2835_BSC_C 							0x0000 /*!< BSC Master Control */
+#define BCM2835_BSC_S 							0x0004 /*!< BSC Master Status */
+#define BCM2835_BSC_DLEN						0x0008 /*!< BSC Master Data Length */
+#define BCM2835_BSC_A 							0x000c /*!< BSC Master Slave Address */
+#define BCM2835_BSC_FIFO						0x0010 /*!< BSC Master Data FIFO */
+#define BCM2835_BSC_DIV							0x0014 /*!< BSC Master Clock Divider */
+#define BCM2835_BSC_DEL							0x0018 /*!< BSC Master Data Delay */
+#define BCM2835_BSC_CLKT						0x001c /*!< BSC Master Clock Stretch Timeout */
+
+/* Register masks for BSC_C */
+#define BCM2835_BSC_C_I2CEN 					0x00008000 /*!< I2C Enable, 0 = disabled, 1 = enabled */
+#define BCM2835_BSC_C_INTR 						0x00000400 /*!< Interrupt on RX */
+#define BCM2835_BSC_C_INTT 						0x00000200 /*!< Interrupt on TX */
+#define BCM2835_BSC_C_INTD 						0x00000100 /*!< Interrupt on DONE */
+#define BCM2835_BSC_C_ST 						0x00000080 /*!< Start transfer, 1 = Start a new transfer */
+#define BCM2835_BSC_C_CLEAR_1 					0x00000020 /*!< Clear FIFO Clear */
+#define BCM2835_BSC_C_CLEAR_2 					0x00000010 /*!< Clear FIFO Clear */
+#define BCM2835_BSC_C_READ 						0x00000001 /*!<	Read transfer */
+
+/* Register masks for BSC_S */
+#define BCM2835_BSC_S_CLKT 						0x00000200 /*!< Clock stretch timeout */
+#define BCM2835_BSC_S_ERR 						0x00000100 /*!< ACK error */
+#define BCM2835_BSC_S_RXF 						0x00000080 /*!< RXF FIFO full, 0 = FIFO is not full, 1 = FIFO is full */
+#define BCM2835_BSC_S_TXE 						0x00000040 /*!< TXE FIFO full, 0 = FIFO is not full, 1 = FIFO is full */
+#define BCM2835_BSC_S_RXD 						0x00000020 /*!< RXD FIFO contains data */
+#define BCM2835_BSC_S_TXD 						0x00000010 /*!< TXD FIFO can accept data */
+#define BCM2835_BSC_S_RXR 						0x00000008 /*!< RXR FIFO needs reading (full) */
+#define BCM2835_BSC_S_TXW 						0x00000004 /*!< TXW FIFO needs writing (full) */
+#define BCM2835_BSC_S_DONE 						0x00000002 /*!< Transfer DONE */
+#define BCM2835_BSC_S_TA 						0x00000001 /*!< Transfer Active */
+
+#define BCM2835_BSC_FIFO_SIZE   				16 /*!< BSC FIFO size */
+
+/*! \brief bcm2835I2CClockDivider
+  Specifies the divider used to generate the I2C clock from the system clock.
+  Clock divided is based on nominal base clock rate of 250MHz
+*/
+typedef enum
+{
+    BCM2835_I2C_CLOCK_DIVIDER_2500   = 2500,      /*!< 2500 = 10us = 100 kHz */
+    BCM2835_I2C_CLOCK_DIVIDER_626    = 626,       /*!< 622 = 2.504us = 399.3610 kHz */
+    BCM2835_I2C_CLOCK_DIVIDER_150    = 150,       /*!< 150 = 60ns = 1.666 MHz (default at reset) */
+    BCM2835_I2C_CLOCK_DIVIDER_148    = 148        /*!< 148 = 59ns = 1.689 MHz */
+} bcm2835I2CClockDivider;
+
+/*! \brief bcm2835I2CReasonCodes
+  Specifies the reason codes for the bcm2835_bsc_write_read() function.
+*/
+typedef enum
+{
+    BCM2835_I2C_REASON_OK   	     = 0x00,      /*!< Success */
+    BCM2835_I2C_REASON_ERROR_NACK    = 0x01,      /*!< Received a NACK */
+    BCM2835_I2C_REASON_ERROR_CLKT    = 0x02,      /*!< Received Clock Stretch Timeout */
+    BCM2835_I2C_REASON_ERROR_DATA    = 0x04       /*!< Not all data is sent / received */
+} bcm2835I2CReasonCodes;
+
+/*! \brief bcm2835BSC
+  State of one BSC (I2C master) controller, passed to the bcm2835_bsc_* functions.
+  When wait is set, transfers sleep in it with the matching BSC interrupt
+  enabled instead of spinning on the status register.
+*/
+typedef struct
+{
+    volatile uint32_t *regs;  /*!< Register base, set by bcm2835_init() */
+    uint8_t pins[2];          /*!< GPIOs of SDA and SCL, both ALT0 */
+    void (*wait)(void *arg);  /*!< Blocks until the BSC interrupt fires, NULL to spin */
+    void *wait_arg;           /*!< Argument passed to wait */
+} bcm2835BSC;
+
+/*! The BSC0 controller */
+extern bcm2835BSC bcm2835_bsc0_ctrl;
+/*! The BSC1 controller */
+extern bcm2835BSC bcm2835_bsc1_ctrl;
+
 /* Defines for ST
    GPIO register offsets from BCM2835_ST_BASE.
    Offsets into the ST Peripheral block in bytes per 12.1 System Timer Registers
@@ -1283,6 +1439,12 @@ extern "C" {
     */
     extern void bcm2835_peri_write_nb(volatile uint32_t* paddr, uint32_t value);
 
+    /*! Orders all peripheral accesses before the call against all accesses after it.
+      Issues a single DMB OSH. Use it to enter or leave a run of _nb accesses to one
+      peripheral when the run does not start or end with a barrier access.
+    */
+    extern void bcm2835_memory_barrier(void);
+
     /*! Alters a number of bits in a 32 peripheral regsiter.
       It reads the current valu and then alters the bits defines as 1 in mask, 
       according to the bit value in value. 
@@ -1311,6 +1473,27 @@ extern "C" {
     */
     extern void bcm2835_gpio_fsel(uint8_t pin, uint8_t mode);
 
+    /*! Adds a function select change to a batch, without touching the hardware.
+      \param[in] batch The batch to add the change to
+      \param[in] pin GPIO number, or one of RPI_GPIO_P1_* from \ref RPiGPIOPin.
+      \param[in] mode Mode to set the pin to, one of BCM2835_GPIO_FSEL_* from \ref bcm2835FunctionSelect
+    */
+    extern void bcm2835_gpio_fsel_stage(bcm2835FselBatch *batch, uint8_t pin, uint8_t mode);
+
+    /*! Applies a batch of function select changes.
+      The GPFSEL registers are shadowed since bcm2835_init(), so each register
+      touched by the batch costs one write and no read; registers whose value
+      does not change are not written at all.
+      \param[in] batch The changes to apply
+    */
+    extern void bcm2835_gpio_fsel_commit(const bcm2835FselBatch *batch);
+
+    /*! Returns the function the given pin is set to, from the GPFSEL shadow.
+      \param[in] pin GPIO number, or one of RPI_GPIO_P1_* from \ref RPiGPIOPin.
+      \return One of BCM2835_GPIO_FSEL_* from \ref bcm2835FunctionSelect
+    */
+    extern uint8_t bcm2835_gpio_get_fsel(uint8_t pin);
+
     /*! Sets the specified pin output to 
       HIGH.
       \param[in] pin GPIO number, or one of RPI_GPIO_P1_* from \ref RPiGPIOPin.
@@ -1347,6 +1530,12 @@ extern "C" {
     */
     extern uint8_t bcm2835_gpio_lev(uint8_t pin);
 
+    /*! Same as bcm2835_gpio_lev() but reads all pins in the mask at once.
+      \param[in] mask Mask of pins to read. Use eg: (1 << RPI_GPIO_P1_03) | (1 << RPI_GPIO_P1_05)
+      \return Mask of the pins in mask that are HIGH
+    */
+    extern uint32_t bcm2835_gpio_lev_multi(uint32_t mask);
+
     /*! Event Detect Status.
       Tests whether the specified pin has detected a level or edge
       as requested by bcm2835_gpio_ren(), bcm2835_gpio_fen(), bcm2835_gpio_hen(), 
@@ -1407,6 +1596,15 @@ extern "C" {
     */
     extern void bcm2835_gpio_clr_fen(uint8_t pin);
 
+    /*! Sets the Rising and Falling Edge Detect Enables of all pins in the mask
+      at once, with a single write to each of GPREN0 and GPFEN0.
+      \param[in] rising Mask of pins whose rising edges are detected
+      \param[in] falling Mask of pins whose falling edges are detected
+      \param[in] mask Mask of pins to update. Other pins are not changed.
+    */
+    extern void bcm2835_gpio_edges_multi(uint32_t rising, uint32_t falling,
+                                         uint32_t mask);
+
     /*! Enable High Detect Enable for the specified pin.
       When a HIGH level is detected on the pin, sets the appropriate pin in Event Detect Status.
       \param[in] pin GPIO number, or one of RPI_GPIO_P1_* from \ref RPiGPIOPin.
@@ -1649,6 +1847,25 @@ extern "C" {
     */
     extern void bcm2835_spi_transfernb(const unsigned char* tbuf, unsigned char* rbuf, uint32_t len);
 
+    /*! Starts a transfer to the currently selected SPI slave.
+      Clears the FIFOs and asserts the CS pins. The CS pins stay asserted
+      until bcm2835_spi_transfer_end() is called.
+      \sa bcm2835_spi_transfer_continue()
+    */
+    extern void bcm2835_spi_transfer_begin(void);
+
+    /*! Transfers bytes within a transfer started with bcm2835_spi_transfer_begin().
+      \param[in] tbuf Buffer of bytes to send. NULL sends zero bytes
+      \param[out] rbuf Received bytes will by put in this buffer. NULL discards them
+      \param[in] len Number of bytes to send/receive
+    */
+    extern void bcm2835_spi_transfer_continue(const unsigned char* tbuf, unsigned char* rbuf, uint32_t len);
+
+    /*! Waits for the current transfer to finish and deasserts the CS pins.
+      \sa bcm2835_spi_transfer_begin()
+    */
+    extern void bcm2835_spi_transfer_end(void);
+
     /*! Transfers any number of bytes to and from the currently selected SPI slave
       using bcm2835_spi_transfernb.
       The returned data from the slave replaces the transmitted data in the buffer.
@@ -1668,6 +1885,27 @@ extern "C" {
 
     extern void bcm2835_spi_readnb(char *rbuf, uint32_t len);
 
+    /*! Writes 9 bit LoSSI words to the currently selected SPI slave.
+      LoSSI mode is enabled for this transfer only. Bit 8 of every word is sent
+      as command/data bit, so commands and data can be interleaved in one buffer.
+      \param[in] words Words to send, BCM2835_SPI_LOSSI_DATA marks data words
+      \param[in] len Number of words
+      \sa bcm2835_spi_lossi_command()
+    */
+    extern void bcm2835_spi_lossi_writenb(const uint16_t* words, uint32_t len);
+
+    /*! Sends a LoSSI command followed by its parameter bytes.
+      \param[in] cmd Command byte, sent with the command/data bit clear
+      \param[in] params Parameter bytes, sent with the command/data bit set
+      \param[in] len Number of parameters, at most BCM2835_SPI_LOSSI_PARAMS_MAX
+    */
+    extern void bcm2835_spi_lossi_command(uint8_t cmd, const uint8_t* params, uint32_t len);
+
+    /*! Sets the LoSSI output hold delay.
+      \param[in] toh Hold time in core clock cycles, 1 to 15
+    */
+    extern void bcm2835_spi_setLoSSIHold(uint8_t toh);
+
     /*! Transfers half-word to the currently selected SPI slave.
       Asserts the currently selected CS pins (as previously set by bcm2835_spi_chipSelect)
       during the transfer.
@@ -1737,6 +1975,84 @@ extern "C" {
     */
     extern void bcm2835_aux_spi_transfernb(const char *tbuf, char *rbuf, uint32_t len);
 
+    /*! Starts a transfer to the AUX SPI slave.
+      \sa bcm2835_aux_spi_transfer_continue()
+    */
+    extern void bcm2835_aux_spi_transfer_begin(void);
+
+    /*! Transfers bytes within a transfer started with bcm2835_aux_spi_transfer_begin().
+      CS stays asserted after the segment unless last is set.
+      \param[in] tbuf Buffer of bytes to send. NULL sends zero bytes
+      \param[out] rbuf Received bytes will by put in this buffer. NULL discards them
+      \param[in] len Number of bytes to send/receive
+      \param[in] last Non-zero if this segment ends the transfer
+    */
+    extern void bcm2835_aux_spi_transfer_continue(const char *tbuf, char *rbuf, uint32_t len, int last);
+
+    /*! Ends a transfer whose last segment was sent without last set,
+      releasing CS by resetting the AUX SPI.
+    */
+    extern void bcm2835_aux_spi_transfer_end(void);
+
+    /*! Sets the AUX SPI chip select.
+      \param[in] cs 0, 1 or 2 for CE0, CE1 or CE2. The pin is switched to ALT4.
+    */
+    extern void bcm2835_aux_spi_chipSelect(uint8_t cs);
+
+    /*! \name AUX SPI controller instances
+      The bcm2835_aux_spi_* functions operate on SPI1. The following functions
+      take the controller, &bcm2835_aux_spi1_ctrl or &bcm2835_aux_spi2_ctrl,
+      and otherwise behave like their bcm2835_aux_spi_* counterparts.
+      @{
+    */
+    extern int bcm2835_auxspi_begin(bcm2835AuxSPI *spi);
+    extern void bcm2835_auxspi_end(bcm2835AuxSPI *spi);
+    extern void bcm2835_auxspi_setClockDivider(bcm2835AuxSPI *spi, uint16_t divider);
+    extern void bcm2835_auxspi_chipSelect(bcm2835AuxSPI *spi, uint8_t cs);
+    extern void bcm2835_auxspi_write(bcm2835AuxSPI *spi, uint16_t data);
+    extern void bcm2835_auxspi_writenb(bcm2835AuxSPI *spi, const char *buf, uint32_t len);
+    extern void bcm2835_auxspi_transfernb(bcm2835AuxSPI *spi, const char *tbuf, char *rbuf, uint32_t len);
+    extern void bcm2835_auxspi_transfer_begin(bcm2835AuxSPI *spi);
+    extern void bcm2835_auxspi_transfer_continue(bcm2835AuxSPI *spi, const char *tbuf, char *rbuf,
+                                                 uint32_t len, int last);
+    extern void bcm2835_auxspi_transfer_end(bcm2835AuxSPI *spi);
+    extern uint8_t bcm2835_auxspi_transfer(bcm2835AuxSPI *spi, uint8_t value);
+
+    /*! Start BSC operations.
+      Switches the SDA and SCL pins of the controller to ALT0 and sets a
+      100 kHz clock.
+      \param[in] bsc The controller
+      \return 1 if successful, 0 otherwise (the controller is not mapped)
+    */
+    extern int bcm2835_bsc_begin(bcm2835BSC *bsc);
+
+    /*! End BSC operations. The SDA and SCL pins are returned to inputs.
+      \param[in] bsc The controller
+    */
+    extern void bcm2835_bsc_end(bcm2835BSC *bsc);
+
+    /*! Sets the I2C clock.
+      \param[in] bsc The controller
+      \param[in] baudrate The desired I2C clock in Hz
+    */
+    extern void bcm2835_bsc_set_baudrate(bcm2835BSC *bsc, uint32_t baudrate);
+
+    /*! Writes and then reads the slave at addr in one combined transaction.
+      The read follows the write with a repeated start if the write fits into
+      the FIFO, otherwise with a stop and a new start. Either part may be empty.
+      \param[in] bsc The controller
+      \param[in] addr 7 bit slave address
+      \param[in] wbuf Bytes to write
+      \param[in] wlen Number of bytes to write
+      \param[out] rbuf Received bytes
+      \param[in] rlen Number of bytes to read
+      \return reason see \ref bcm2835I2CReasonCodes
+    */
+    extern uint8_t bcm2835_bsc_write_read(bcm2835BSC *bsc, uint8_t addr,
+                                          const char* wbuf, uint32_t wlen,
+                                          char* rbuf, uint32_t rlen);
+    /*! @} */
+
     /*! Transfers one byte to and from the AUX SPI slave.
       Clocks the 8 bit value out on MOSI, and simultaneously clocks in data from MISO. 
       Returns the read data byte from the slave.
@@ -1758,11 +2074,46 @@ extern "C" {
     extern uint64_t bcm2835_st_read(void);
 
     /*! Delays for the specified number of microseconds with offset.
+      Busy waits until the System Timer Counter reaches offset_micros + micros,
+      so offset_micros is a value of bcm2835_st_read(). Without a mapped
+      System Timer it waits on bcm2835_micros() instead.
       \param[in] offset_micros Offset in microseconds
       \param[in] micros Delay in microseconds
     */
     extern void bcm2835_st_delay(uint64_t offset_micros, uint64_t micros);
 
+    /*! Selects the clock source of bcm2835_nanos() and bcm2835_micros().
+      Prefers the AArch64 generic timer (CNTVCT_EL0 at CNTFRQ_EL0), then the System
+      Timer if it is mapped, then the kernel clock. Called by bcm2835_init().
+      \return the selected source, one of bcm2835ClockSource
+    */
+    extern uint8_t bcm2835_clock_init(void);
+
+    /*! Returns a monotonic time in nanoseconds.
+      The resolution is that of the clock source, see bcm2835_clock_init().
+      \return the current time in nanoseconds
+    */
+    extern uint64_t bcm2835_nanos(void);
+
+    /*! Returns a monotonic time in microseconds.
+      \return the current time in microseconds
+      \sa bcm2835_nanos()
+    */
+    extern uint64_t bcm2835_micros(void);
+
+    /*! Busy waits for the specified number of nanoseconds.
+      Meant for short setup and hold times; use bcm2835_delayMicroseconds() for longer waits.
+      \param[in] nanos Delay in nanoseconds
+    */
+    extern void bcm2835_delayNanoseconds(uint64_t nanos);
+
+    /*! Busy waits until bcm2835_micros() reaches the given time.
+      Like bcm2835_st_delay(), but on the clock source of bcm2835_micros().
+      \param[in] micros Time in microseconds
+      \sa bcm2835_clock_init()
+    */
+    extern void bcm2835_delayUntil(uint64_t micros);
+
     /*! @}  */
 #ifdef __cplusplus
 }
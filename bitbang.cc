@@ -0,0 +1,171 @@
+#include "bitbang.h"
+#include "bcm2835.h"
+
+#include <l4/sys/err.h>
+
+Bitbang_spi_bus::Bitbang_spi_bus(l4_uint8_t sclk, l4_uint8_t mosi,
+                                 l4_uint8_t miso, l4_uint8_t const *cs,
+                                 unsigned ncs)
+: _sclk(sclk), _mosi(mosi), _miso(miso), _ncs(ncs < Max_cs ? ncs : (unsigned)Max_cs)
+{
+  for (unsigned i = 0; i < _ncs; i++)
+    _cs[i] = cs[i];
+}
+
+int
+Bitbang_spi_bus::init(l4_uint8_t mode, l4_uint32_t speed_hz)
+{
+  if (mode > 3 || speed_hz == 0 || _ncs == 0 || _sclk > 31 || _mosi > 31 || _miso > 31)
+    return -L4_EINVAL;
+
+  l4_uint32_t cs_mask = 0;
+  for (unsigned i = 0; i < _ncs; i++) {
+    if (_cs[i] > 31)
+      return -L4_EINVAL;
+    cs_mask |= 1U << _cs[i];
+  }
+
+  l4_uint32_t sclk = 1U << _sclk;
+  l4_uint32_t mosi = 1U << _mosi;
+  bool cpol = mode & 2;
+  bool cpha = mode & 1;
+
+  /* Level of the clock after the leading and trailing edge */
+  l4_uint32_t lead_set = cpol ? 0 : sclk;
+  l4_uint32_t lead_clr = cpol ? sclk : 0;
+
+  _idle = Masks{lead_clr, lead_set};
+  if (!cpha) {
+    /* Data is valid before the leading edge, which samples it */
+    _bit[0] = Masks{_idle.set, _idle.clr | mosi};
+    _bit[1] = Masks{_idle.set | mosi, _idle.clr};
+    _sample = Masks{lead_set, lead_clr};
+  } else {
+    /* Data changes on the leading edge, the trailing edge samples it */
+    _bit[0] = Masks{lead_set, lead_clr | mosi};
+    _bit[1] = Masks{lead_set | mosi, lead_clr};
+    _sample = _idle;
+  }
+
+  bcm2835_gpio_set_multi(cs_mask);
+  apply(_idle);
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  for (unsigned i = 0; i < _ncs; i++)
+    bcm2835_gpio_fsel_stage(&pins, _cs[i], BCM2835_GPIO_FSEL_OUTP);
+  bcm2835_gpio_fsel_stage(&pins, _sclk, BCM2835_GPIO_FSEL_OUTP);
+  bcm2835_gpio_fsel_stage(&pins, _mosi, BCM2835_GPIO_FSEL_OUTP);
+  bcm2835_gpio_fsel_stage(&pins, _miso, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_commit(&pins);
+
+  calibrate();
+
+  l4_uint32_t half_ns = 500000000U / speed_hz;
+  l4_uint32_t busy_ns = 2 * _write_ns;
+  _loops = half_ns > busy_ns
+           ? (l4_uint32_t)((l4_uint64_t)(half_ns - busy_ns) * _loops_per_us / 1000)
+           : 0;
+  return L4_EOK;
+}
+
+/* Measures the delay loop and the cost of a GPIO mask write, so that the
+ * half cycle delay only pads what the register accesses leave. Each run is
+ * doubled until it spans Min_us, which keeps the error small even when the
+ * clock is the KIP clock with its millisecond resolution. */
+void
+Bitbang_spi_bus::calibrate()
+{
+  enum { Min_us = 10000 };
+
+  l4_uint64_t loops = 1000;
+  l4_uint64_t us;
+  for (;;) {
+    l4_uint64_t start = bcm2835_micros();
+    for (volatile l4_uint32_t i = (l4_uint32_t)loops; i; i--)
+      ;
+    us = bcm2835_micros() - start;
+    if (us >= Min_us)
+      break;
+    loops *= 2;
+  }
+  _loops_per_us = loops / us ? (l4_uint32_t)(loops / us) : 1;
+
+  l4_uint64_t writes = 1000;
+  l4_uint64_t ns;
+  for (;;) {
+    l4_uint64_t start = bcm2835_nanos();
+    for (l4_uint64_t i = 0; i < writes; i++)
+      bcm2835_gpio_set_multi(0);
+    ns = bcm2835_nanos() - start;
+    if (ns >= Min_us * 1000ULL)
+      break;
+    writes *= 2;
+  }
+  _write_ns = (l4_uint32_t)(ns / writes);
+}
+
+void
+Bitbang_spi_bus::delay() const
+{
+  for (volatile l4_uint32_t i = _loops; i; i--)
+    ;
+}
+
+void
+Bitbang_spi_bus::apply(Masks const &m)
+{
+  if (m.set)
+    bcm2835_gpio_set_multi(m.set);
+  if (m.clr)
+    bcm2835_gpio_clr_multi(m.clr);
+}
+
+l4_uint8_t
+Bitbang_spi_bus::shift(l4_uint8_t out)
+{
+  l4_uint8_t in = 0;
+
+  for (int bit = 7; bit >= 0; bit--) {
+    apply(_bit[(out >> bit) & 1]);
+    delay();
+    apply(_sample);
+    in = (in << 1) | bcm2835_gpio_lev(_miso);
+    delay();
+  }
+  return in;
+}
+
+void
+Bitbang_spi_bus::hw_select(l4_uint8_t cs)
+{
+  if (cs < _ncs || cs == Cs_none)
+    _sel = cs;
+}
+
+void
+Bitbang_spi_bus::hw_begin()
+{
+  apply(_idle);
+  if (_sel != Cs_none)
+    bcm2835_gpio_clr_multi(1U << _cs[_sel]);
+  delay();
+}
+
+void
+Bitbang_spi_bus::xfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf,
+                      l4_uint32_t len, bool)
+{
+  for (l4_uint32_t i = 0; i < len; i++) {
+    l4_uint8_t in = shift(tbuf ? tbuf[i] : 0);
+    if (rbuf)
+      rbuf[i] = in;
+  }
+}
+
+void
+Bitbang_spi_bus::hw_end()
+{
+  apply(_idle);
+  delay();
+  if (_sel != Cs_none)
+    bcm2835_gpio_set_multi(1U << _cs[_sel]);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "spi_bus.h"
+
+/**
+ * SPI master clocked in software on GPIO bank 0.
+ *
+ * Every half clock cycle is a GPSET0/GPCLR0 mask write. The masks for a 0
+ * and a 1 bit are computed once per mode, so shifting a bit is two table
+ * lookups, the mask writes and, on the sampling edge, one GPLEV0 read.
+ * Delays are busy loops calibrated against the microsecond clock. Chip
+ * selects are active low GPIO outputs.
+ */
+class Bitbang_spi_bus : public Spi_bus
+{
+public:
+  enum { Max_cs = 3 };
+
+  Bitbang_spi_bus(l4_uint8_t sclk, l4_uint8_t mosi, l4_uint8_t miso,
+                  l4_uint8_t const *cs, unsigned ncs);
+
+  /**
+   * Configure the pins, calibrate the delay loop and select SPI `mode`
+   * (0 to 3) at roughly `speed_hz`.
+   */
+  int init(l4_uint8_t mode, l4_uint32_t speed_hz);
+
+  unsigned chip_selects() const override { return _ncs; }
+  void xfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf, l4_uint32_t len,
+            bool last) override;
+
+protected:
+  void hw_select(l4_uint8_t cs) override;
+  void hw_begin() override;
+  void hw_end() override;
+
+private:
+  struct Masks
+  {
+    l4_uint32_t set;
+    l4_uint32_t clr;
+  };
+
+  void calibrate();
+  void delay() const;
+  l4_uint8_t shift(l4_uint8_t out);
+
+  static void apply(Masks const &m);
+
+  l4_uint8_t _sclk, _mosi, _miso;
+  l4_uint8_t _cs[Max_cs];
+  unsigned _ncs;
+  l4_uint8_t _sel = 0;
+
+  /// First half cycle of a 0 and a 1 bit: data and the clock edge before it.
+  Masks _bit[2];
+  /// Second half cycle, the clock edge on which MISO is sampled.
+  Masks _sample;
+  /// Clock back to its idle level.
+  Masks _idle;
+
+  l4_uint32_t _write_ns = 0;
+  l4_uint32_t _loops_per_us = 1;
+  l4_uint32_t _loops = 0;
+};
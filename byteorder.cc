@@ -0,0 +1,48 @@
+#include "byteorder.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+void
+bswap16_copy(void *dst, void const *src, l4_uint32_t n)
+{
+  l4_uint8_t *d = static_cast<l4_uint8_t *>(dst);
+  l4_uint8_t const *s = static_cast<l4_uint8_t const *>(src);
+  l4_uint32_t bytes = n * 2;
+  l4_uint32_t i = 0;
+
+#ifdef __ARM_NEON
+  for (; i + 16 <= bytes; i += 16)
+    vst1q_u8(d + i, vrev16q_u8(vld1q_u8(s + i)));
+#endif
+
+  for (; i < bytes; i += 2) {
+    l4_uint8_t b0 = s[i];
+    d[i] = s[i + 1];
+    d[i + 1] = b0;
+  }
+}
+
+void
+bswap32_copy(void *dst, void const *src, l4_uint32_t n)
+{
+  l4_uint8_t *d = static_cast<l4_uint8_t *>(dst);
+  l4_uint8_t const *s = static_cast<l4_uint8_t const *>(src);
+  l4_uint32_t bytes = n * 4;
+  l4_uint32_t i = 0;
+
+#ifdef __ARM_NEON
+  for (; i + 16 <= bytes; i += 16)
+    vst1q_u8(d + i, vrev32q_u8(vld1q_u8(s + i)));
+#endif
+
+  for (; i < bytes; i += 4) {
+    l4_uint8_t b0 = s[i];
+    l4_uint8_t b1 = s[i + 1];
+    d[i] = s[i + 3];
+    d[i + 1] = s[i + 2];
+    d[i + 2] = b1;
+    d[i + 3] = b0;
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <l4/sys/types.h>
+
+/**
+ * Bulk byte order conversion between word arrays and the SPI byte stream.
+ *
+ * Both functions copy `n` words from `src` to `dst` and reverse the bytes
+ * of every word. Buffers need no alignment and may be identical. On NEON
+ * capable CPUs 16 bytes are converted per instruction.
+ */
+void bswap16_copy(void *dst, void const *src, l4_uint32_t n);
+void bswap32_copy(void *dst, void const *src, l4_uint32_t n);
+
+/// True if words sent in `big_endian` order need their bytes reversed.
+inline bool
+bswap_needed(bool big_endian)
+{
+  return big_endian != (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
+}
@@ -0,0 +1,64 @@
+#include "coalesce.h"
+
+#include <cstring>
+
+int
+Write_coalescer::configure(L4Re::Util::Br_manager_timeout_hooks *timeouts,
+                           Spi_bus *bus, l4_uint8_t cs, l4_uint32_t threshold,
+                           l4_uint32_t deadline_us)
+{
+  if (threshold > Max_len)
+    return -L4_EINVAL;
+
+  flush();
+
+  _timeouts = timeouts;
+  _bus = bus;
+  _cs = cs;
+  _threshold = threshold;
+  _deadline = deadline_us;
+  return L4_EOK;
+}
+
+void
+Write_coalescer::write(l4_uint8_t const *buf, l4_uint32_t len)
+{
+  if (_len + len > Max_len)
+    flush();
+
+  std::memcpy(_buf + _len, buf, len);
+  _len += len;
+
+  if (_len >= _threshold)
+    flush();
+  else if (!_armed) {
+    _timeouts->add_timeout(this, _timeouts->now() + _deadline);
+    _armed = true;
+  }
+}
+
+void
+Write_coalescer::flush()
+{
+  if (_armed) {
+    _timeouts->remove_timeout(this);
+    _armed = false;
+  }
+
+  if (!_len)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    _bus->select(_cs);
+    _bus->write(_buf, _len);
+  }
+  _len = 0;
+}
+
+void
+Write_coalescer::expired()
+{
+  _armed = false;
+  flush();
+}
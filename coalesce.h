@@ -0,0 +1,40 @@
+#pragma once
+
+#include "spi_bus.h"
+
+#include <l4/re/util/br_manager>
+#include <l4/sys/cxx/ipc_timeout_queue>
+
+/**
+ * Write-coalescing buffer for one chip select.
+ *
+ * Small writes are collected until `threshold` bytes are pending or
+ * `deadline_us` microseconds have passed since the first buffered write,
+ * and then sent as a single FIFO burst. The deadline runs as a timeout of
+ * the server loop, so flushing never races with the write path.
+ */
+class Write_coalescer : public L4::Ipc_svr::Timeout_queue::Timeout
+{
+public:
+  enum { Max_len = 512 };
+
+  int configure(L4Re::Util::Br_manager_timeout_hooks *timeouts,
+                Spi_bus *bus, l4_uint8_t cs, l4_uint32_t threshold, l4_uint32_t deadline_us);
+
+  bool enabled() const { return _threshold != 0; }
+
+  void write(l4_uint8_t const *buf, l4_uint32_t len);
+  void flush();
+
+  void expired() override;
+
+private:
+  L4Re::Util::Br_manager_timeout_hooks *_timeouts = nullptr;
+  bool _armed = false;
+  Spi_bus *_bus;
+  l4_uint8_t _cs;
+  l4_uint32_t _threshold = 0;
+  l4_uint32_t _deadline;
+  l4_uint32_t _len = 0;
+  l4_uint8_t _buf[Max_len];
+};
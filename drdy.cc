@@ -0,0 +1,74 @@
+#include "drdy.h"
+#include "bcm2835.h"
+#include "gpio_pins.h"
+#include "spi.h"
+
+#include <cstring>
+
+int
+Drdy_trigger::arm(Spi_bus *bus, l4_uint8_t cs, l4_uint8_t pin, l4_uint8_t edges,
+                  l4_uint8_t const *tbuf, l4_uint32_t len, l4_uint32_t slots)
+{
+  if (pin >= 32 || len == 0 || len > Max_len
+      || !(edges & (SPI_EDGE_RISING | SPI_EDGE_FALLING)))
+    return -L4_EINVAL;
+
+  disarm();
+
+  int err = gpio_pins_claim(1U << pin);
+  if (err < 0)
+    return err;
+
+  err = _ring.alloc(len, slots);
+  if (err < 0) {
+    gpio_pins_release(1U << pin);
+    return err;
+  }
+
+  _bus = bus;
+  _cs = cs;
+  _pin = pin;
+  _edges = edges;
+  _len = len;
+  std::memcpy(_tbuf, tbuf, len);
+
+  bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_set_eds(pin);
+  if (edges & SPI_EDGE_RISING)
+    bcm2835_gpio_ren(pin);
+  if (edges & SPI_EDGE_FALLING)
+    bcm2835_gpio_fen(pin);
+
+  gpio_mask = 1U << pin;
+  gpio_irq.add(this);
+  return L4_EOK;
+}
+
+void
+Drdy_trigger::disarm()
+{
+  if (!armed())
+    return;
+
+  bcm2835_gpio_clr_ren(_pin);
+  bcm2835_gpio_clr_fen(_pin);
+  bcm2835_gpio_set_eds(_pin);
+
+  gpio_irq.remove(this);
+  gpio_pins_release(gpio_mask);
+  gpio_mask = 0;
+  _ring.free();
+}
+
+void
+Drdy_trigger::gpio_event(l4_uint32_t, l4_uint64_t now)
+{
+  l4_uint8_t rbuf[Max_len];
+
+  {
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    _bus->select(_cs);
+    _bus->transfer(_tbuf, rbuf, _len);
+  }
+  _ring.push(now, rbuf, _len);
+}
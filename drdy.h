@@ -0,0 +1,35 @@
+#pragma once
+
+#include "gpio_irq.h"
+#include "ring.h"
+#include "spi_bus.h"
+
+/**
+ * Data-ready triggered transfer.
+ *
+ * Runs a preconfigured transfer on every detected edge of a GPIO and
+ * appends the received bytes with a timestamp to a shared ring.
+ */
+class Drdy_trigger : public Gpio_listener
+{
+public:
+  enum { Max_len = 64 };
+
+  int arm(Spi_bus *bus, l4_uint8_t cs, l4_uint8_t pin, l4_uint8_t edges,
+          l4_uint8_t const *tbuf, l4_uint32_t len, l4_uint32_t slots);
+  void disarm();
+
+  bool armed() const { return gpio_mask != 0; }
+  L4::Cap<L4Re::Dataspace> ring() const { return _ring.ds(); }
+
+  void gpio_event(l4_uint32_t pending, l4_uint64_t now) override;
+
+private:
+  Spi_bus *_bus;
+  l4_uint8_t _cs;
+  l4_uint8_t _pin;
+  l4_uint8_t _edges;
+  l4_uint32_t _len;
+  l4_uint8_t _tbuf[Max_len];
+  Sample_ring _ring;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <l4/re/dataspace>
+#include <l4/sys/capability>
+#include <l4/sys/cxx/ipc_iface>
+#include <l4/sys/cxx/ipc_types>
+
+enum
+{
+  GPIO_PROTO = 0x46,
+};
+
+enum
+{
+  GPIO_MODE_INPUT = 0,
+  GPIO_MODE_OUTPUT = 1,
+};
+
+enum
+{
+  GPIO_EDGE_RISING = 1,
+  GPIO_EDGE_FALLING = 2,
+};
+
+/**
+ * Payload of a record in the edge event ring (see ring.h).
+ *
+ * The timestamp of the record is the time the interrupt was serviced.
+ */
+struct Gpio_event_record
+{
+  l4_uint8_t pin;
+  l4_uint8_t edge;       ///< GPIO_EDGE_RISING or GPIO_EDGE_FALLING
+  l4_uint16_t reserved;
+};
+
+/**
+ * GPIO bank 0 (GPIO 0 to 31).
+ *
+ * Every call takes a mask of pins, so any number of lines is switched
+ * with one call. Pins owned by a bus of the driver cannot be used; calls
+ * naming them fail with -L4_EPERM. Calls that configure or drive pins
+ * fail with -L4_EBUSY for pins reserved as SPI chip select, by a
+ * data-ready trigger or by another client's edge events.
+ */
+struct Gpio : L4::Kobject_t<Gpio, L4::Kobject, GPIO_PROTO>
+{
+  /// Pins available to clients.
+  L4_INLINE_RPC(int, pins, (l4_uint32_t *mask));
+  /// Make the pins in `mask` inputs or outputs (GPIO_MODE_*).
+  L4_INLINE_RPC(int, configure, (l4_uint32_t mask, l4_uint8_t mode));
+  /// Drive the pins in `set` high and then the pins in `clr` low.
+  L4_INLINE_RPC(int, set_clr, (l4_uint32_t set, l4_uint32_t clr));
+  /// Drive the pins in `mask` to the levels given by `value`.
+  L4_INLINE_RPC(int, write, (l4_uint32_t value, l4_uint32_t mask));
+  /// Levels of the pins in `mask`, one bit per pin.
+  L4_INLINE_RPC(int, read, (l4_uint32_t mask, l4_uint32_t *levels));
+  /**
+   * Capture the `edges` (GPIO_EDGE_*) of the pins in `mask`.
+   *
+   * The pins are made inputs. Every edge is appended as Gpio_event_record
+   * to a ring of `slots` records, returned as read-only dataspace `ring`.
+   * Arming again replaces the previous pin set and ring. Pins already used
+   * by a data-ready trigger or a chip select fail with -L4_EBUSY.
+   */
+  L4_INLINE_RPC(int, arm_events,
+                (l4_uint32_t mask, l4_uint8_t edges, l4_uint32_t slots,
+                 L4::Ipc::Out<L4::Cap<L4Re::Dataspace> > ring));
+  L4_INLINE_RPC(int, disarm_events, ());
+  typedef L4::Typeid::Rpcs<pins_t, configure_t, set_clr_t, write_t,
+                           read_t, arm_events_t, disarm_events_t> Rpcs;
+};
@@ -0,0 +1,77 @@
+#include "gpio_events.h"
+#include "bcm2835.h"
+#include "gpio.h"
+#include "gpio_pins.h"
+
+int
+Gpio_events::arm(l4_uint32_t mask, l4_uint8_t edges, l4_uint32_t slots)
+{
+  if (!mask || !(edges & (GPIO_EDGE_RISING | GPIO_EDGE_FALLING)))
+    return -L4_EINVAL;
+
+  disarm();
+
+  int err = gpio_pins_claim(mask);
+  if (err < 0)
+    return err;
+
+  err = _ring.alloc(sizeof(Gpio_event_record), slots);
+  if (err < 0) {
+    gpio_pins_release(mask);
+    return err;
+  }
+
+  _edges = edges;
+
+  bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+  for (l4_uint8_t pin = 0; pin < 32; pin++)
+    if (mask & (1U << pin))
+      bcm2835_gpio_fsel_stage(&pins, pin, BCM2835_GPIO_FSEL_INPT);
+  bcm2835_gpio_fsel_commit(&pins);
+
+  bcm2835_gpio_set_eds_multi(mask);
+  bcm2835_gpio_edges_multi(edges & GPIO_EDGE_RISING ? mask : 0,
+                           edges & GPIO_EDGE_FALLING ? mask : 0, mask);
+
+  gpio_mask = mask;
+  gpio_irq.add(this);
+  return L4_EOK;
+}
+
+void
+Gpio_events::disarm()
+{
+  if (!armed())
+    return;
+
+  bcm2835_gpio_edges_multi(0, 0, gpio_mask);
+  bcm2835_gpio_set_eds_multi(gpio_mask);
+
+  gpio_irq.remove(this);
+  gpio_pins_release(gpio_mask);
+  gpio_mask = 0;
+  _ring.free();
+}
+
+void
+Gpio_events::gpio_event(l4_uint32_t pending, l4_uint64_t now)
+{
+  /* GPEDS does not record the direction: with both edges enabled the level
+   * after the event tells them apart. */
+  l4_uint32_t levels = 0;
+  if (_edges == (GPIO_EDGE_RISING | GPIO_EDGE_FALLING))
+    levels = bcm2835_gpio_lev_multi(pending);
+
+  for (; pending; pending &= pending - 1) {
+    l4_uint8_t pin = __builtin_ctz(pending);
+
+    Gpio_event_record rec;
+    rec.pin = pin;
+    if (_edges != (GPIO_EDGE_RISING | GPIO_EDGE_FALLING))
+      rec.edge = _edges;
+    else
+      rec.edge = (levels & (1U << pin)) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+    rec.reserved = 0;
+    _ring.push(now, &rec, sizeof(rec));
+  }
+}
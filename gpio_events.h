@@ -0,0 +1,27 @@
+#pragma once
+
+#include "gpio_irq.h"
+#include "ring.h"
+
+/**
+ * GPIO edge event capture.
+ *
+ * Enables edge detection on a set of bank 0 pins and appends one
+ * Gpio_event_record (see gpio.h) with a timestamp to a shared ring for
+ * every detected edge, so clients consume the events without an IPC each.
+ */
+class Gpio_events : public Gpio_listener
+{
+public:
+  int arm(l4_uint32_t mask, l4_uint8_t edges, l4_uint32_t slots);
+  void disarm();
+
+  bool armed() const { return gpio_mask != 0; }
+  L4::Cap<L4Re::Dataspace> ring() const { return _ring.ds(); }
+
+  void gpio_event(l4_uint32_t pending, l4_uint64_t now) override;
+
+private:
+  l4_uint8_t _edges;
+  Sample_ring _ring;
+};
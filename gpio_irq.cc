@@ -0,0 +1,58 @@
+#include "gpio_irq.h"
+#include "bcm2835.h"
+
+#include <l4/sys/irq>
+
+#include <algorithm>
+
+Gpio_irq gpio_irq;
+
+int
+Gpio_irq::attach(L4Re::Util::Object_registry *registry,
+                 L4::Cap<L4vbus::Vbus> vbus)
+{
+  L4::Cap<L4::Irq> irq = registry->register_irq_obj(this);
+  if (!irq.is_valid())
+    return -L4_ENOMEM;
+
+  int err = l4_error(vbus->bind(BCM2835_IRQ_GPIO0, irq));
+  if (err < 0)
+    return err;
+
+  return l4_error(irq->unmask());
+}
+
+void
+Gpio_irq::add(Gpio_listener *l)
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  _listeners.push_back(l);
+}
+
+void
+Gpio_irq::remove(Gpio_listener *l)
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  _listeners.erase(std::remove(_listeners.begin(), _listeners.end(), l),
+                   _listeners.end());
+}
+
+void
+Gpio_irq::handle_irq()
+{
+  std::unique_lock<std::mutex> guard(_lock);
+  l4_uint32_t mask = 0;
+  for (Gpio_listener *l : _listeners)
+    mask |= l->gpio_mask;
+
+  l4_uint32_t pending = bcm2835_gpio_eds_multi(mask);
+  bcm2835_gpio_set_eds_multi(pending);
+
+  l4_uint64_t now = bcm2835_micros();
+  for (Gpio_listener *l : _listeners)
+    if (pending & l->gpio_mask)
+      l->gpio_event(pending & l->gpio_mask, now);
+  guard.unlock();
+
+  obj_cap()->unmask();
+}
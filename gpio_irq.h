@@ -0,0 +1,49 @@
+#pragma once
+
+#include <l4/re/util/object_registry>
+#include <l4/sys/cxx/ipc_epiface>
+#include <l4/vbus/vbus>
+
+#include <mutex>
+#include <vector>
+
+/**
+ * Receiver of GPIO edge events.
+ *
+ * `gpio_mask` selects the bank 0 pins the listener is interested in.
+ */
+class Gpio_listener
+{
+public:
+  virtual void gpio_event(l4_uint32_t pending, l4_uint64_t now) = 0;
+
+  l4_uint32_t gpio_mask = 0;
+
+protected:
+  ~Gpio_listener() = default;
+};
+
+/**
+ * Handler of the GPIO bank 0 interrupt.
+ *
+ * Collects all pending events with a single GPEDS0 read, acknowledges them
+ * and hands them to the listeners. Listeners are added and removed from
+ * the bus worker threads, the interrupt is handled on the main thread.
+ */
+class Gpio_irq : public L4::Irqep_t<Gpio_irq>
+{
+public:
+  int attach(L4Re::Util::Object_registry *registry,
+             L4::Cap<L4vbus::Vbus> vbus);
+
+  void add(Gpio_listener *l);
+  void remove(Gpio_listener *l);
+
+  void handle_irq();
+
+private:
+  std::mutex _lock;
+  std::vector<Gpio_listener *> _listeners;
+};
+
+extern Gpio_irq gpio_irq;
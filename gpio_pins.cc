@@ -0,0 +1,45 @@
+#include "gpio_pins.h"
+
+#include <l4/sys/err.h>
+
+#include <mutex>
+
+l4_uint32_t const gpio_client_pins =
+    ~(0x0000000fU | 0x00000f80U | 0x003f0000U | 0x0fc00000U);
+
+static std::mutex gpio_pins_lock;
+static l4_uint32_t gpio_pins_claimed;
+
+int
+gpio_pins_claim(l4_uint32_t mask)
+{
+  if (mask & ~gpio_client_pins)
+    return -L4_EPERM;
+
+  std::lock_guard<std::mutex> guard(gpio_pins_lock);
+  if (mask & gpio_pins_claimed)
+    return -L4_EBUSY;
+
+  gpio_pins_claimed |= mask;
+  return L4_EOK;
+}
+
+void
+gpio_pins_release(l4_uint32_t mask)
+{
+  std::lock_guard<std::mutex> guard(gpio_pins_lock);
+  gpio_pins_claimed &= ~mask;
+}
+
+int
+gpio_pins_check(l4_uint32_t mask, l4_uint32_t own)
+{
+  if (mask & ~gpio_client_pins)
+    return -L4_EPERM;
+
+  std::lock_guard<std::mutex> guard(gpio_pins_lock);
+  if (mask & gpio_pins_claimed & ~own)
+    return -L4_EBUSY;
+
+  return L4_EOK;
+}
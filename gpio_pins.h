@@ -0,0 +1,32 @@
+#pragma once
+
+#include <l4/sys/types.h>
+
+/**
+ * Bank 0 pins clients may use: all but those of BSC0 (0, 1), BSC1 (2, 3),
+ * SPI0 (7 to 11), SPI1 (16 to 21) and the software SPI bus (22 to 27).
+ */
+extern l4_uint32_t const gpio_client_pins;
+
+/**
+ * Reserve the client pins in `mask` for one user (a GPIO chip select, a
+ * data-ready trigger or the edge event capture).
+ *
+ * \retval L4_EOK     pins reserved
+ * \retval -L4_EPERM  a pin is not a client pin
+ * \retval -L4_EBUSY  a pin is already reserved
+ */
+int gpio_pins_claim(l4_uint32_t mask);
+
+/// Give back pins reserved with gpio_pins_claim().
+void gpio_pins_release(l4_uint32_t mask);
+
+/**
+ * Check that a client may drive the pins in `mask`, given that it reserved
+ * the pins in `own` itself.
+ *
+ * \retval L4_EOK     all pins usable
+ * \retval -L4_EPERM  a pin is not a client pin
+ * \retval -L4_EBUSY  a pin is reserved by someone else
+ */
+int gpio_pins_check(l4_uint32_t mask, l4_uint32_t own);
@@ -1,15 +1,133 @@
 #pragma once
 
-#include <cstdio>
-#include <l4/drivers/io_regblock.h>
-#include <l4/io/io.h>
-#include <l4/vbus/vbus>
+#include <stdint.h>
 #include <sys/types.h>
-typedef u_int32_t uint32_t;
 
-extern L4::Io_register_block_mmio *spi;
+/* Register access to the mapped peripheral blocks.
+ *
+ * Each block the driver uses is attached as its own window by
+ * bcm2835_map_peripherals() (mmio.h), which stores the virtual address in
+ * the matching base pointer (bcm2835_gpio, bcm2835_st, ...). Register
+ * pointers are therefore plain virtual addresses. Everything here is
+ * inline, so register loops compile down to plain loads and stores the
+ * compiler can schedule.
+ */
 
-uint32_t bcm2835_peri_read(long unsigned int offset);
-uint32_t bcm2835_peri_read_nb(long unsigned int offset);
-void bcm2835_peri_write(long unsigned int offset, uint32_t value);
-void bcm2835_peri_write_nb(long unsigned int offset, uint32_t value);
+/* Barriers around the accessors without the _nb suffix.
+ *
+ * Device-nGnRE keeps accesses to one peripheral in order but says nothing
+ * about two different peripherals, so only the switch from one block to
+ * another needs a DMB, and only in the outer shareable domain. A barrier
+ * access orders everything before it with a full DMB and then fences its
+ * own access: a read only has to complete before what follows (DMB LD), a
+ * write also has to be visible to later reads (DMB). The _nb accessors are
+ * plain loads and stores and belong inside a run on one peripheral that
+ * starts and ends with a barrier access or bcm2835_memory_barrier().
+ */
+#if defined(__aarch64__)
+#define BCM2835_DMB(opt) asm volatile("dmb " #opt ::: "memory")
+#else
+#define BCM2835_DMB(opt) __sync_synchronize()
+#endif
+
+/* Host builds of the checks in test/ define BCM2835_SIM, which sends every
+ * register access and barrier to the simulated register file of
+ * test/sim.h. */
+#if defined(BCM2835_SIM)
+extern "C" uint32_t bcm2835_sim_read(volatile uint32_t *paddr);
+extern "C" void bcm2835_sim_write(volatile uint32_t *paddr, uint32_t value);
+extern "C" void bcm2835_sim_barrier(void);
+#undef BCM2835_DMB
+#define BCM2835_DMB(opt) bcm2835_sim_barrier()
+#define BCM2835_LOAD(paddr) bcm2835_sim_read(paddr)
+#define BCM2835_STORE(paddr, value) bcm2835_sim_write(paddr, value)
+#else
+#define BCM2835_LOAD(paddr) (*(paddr))
+#define BCM2835_STORE(paddr, value) (*(paddr) = (value))
+#endif
+
+extern "C" {
+
+inline void
+bcm2835_memory_barrier()
+{ BCM2835_DMB(osh); }
+
+inline uint32_t
+bcm2835_peri_read(volatile uint32_t *paddr)
+{
+  BCM2835_DMB(osh);
+  uint32_t v = BCM2835_LOAD(paddr);
+  BCM2835_DMB(oshld);
+  return v;
+}
+
+inline uint32_t
+bcm2835_peri_read_nb(volatile uint32_t *paddr)
+{ return BCM2835_LOAD(paddr); }
+
+inline void
+bcm2835_peri_write(volatile uint32_t *paddr, uint32_t value)
+{
+  BCM2835_DMB(osh);
+  BCM2835_STORE(paddr, value);
+  BCM2835_DMB(osh);
+}
+
+inline void
+bcm2835_peri_write_nb(volatile uint32_t *paddr, uint32_t value)
+{ BCM2835_STORE(paddr, value); }
+
+}
+
+/**
+ * Register `OFFSET` of the peripheral block whose base pointer is `REGS`.
+ *
+ * `OFFSET` is a compile-time byte offset, e.g. Bcm2835_reg<bcm2835_spi0,
+ * BCM2835_SPI0_FIFO>, so the address is the block base plus a constant.
+ * read() and write() carry the same barriers as bcm2835_peri_read() and
+ * bcm2835_peri_write(), read_nb() and write_nb() none.
+ */
+template<volatile uint32_t *&REGS, uint32_t OFFSET>
+struct Bcm2835_reg
+{
+  static volatile uint32_t *ptr() { return REGS + OFFSET / 4; }
+
+  static uint32_t read()
+  {
+    BCM2835_DMB(osh);
+    uint32_t v = BCM2835_LOAD(ptr());
+    BCM2835_DMB(oshld);
+    return v;
+  }
+
+  static void write(uint32_t value)
+  {
+    BCM2835_DMB(osh);
+    BCM2835_STORE(ptr(), value);
+    BCM2835_DMB(osh);
+  }
+
+  static uint32_t read_nb() { return BCM2835_LOAD(ptr()); }
+  static void write_nb(uint32_t value) { BCM2835_STORE(ptr(), value); }
+};
+
+/**
+ * Bit field of `WIDTH` bits at bit `SHIFT` of a register.
+ *
+ * Everything is constexpr, so a register value composed of constant field
+ * values, e.g. Field_a::val(1) | Field_b::val(4), is a single immediate
+ * and several fields are updated with one write of the combined value.
+ */
+template<unsigned SHIFT, unsigned WIDTH>
+struct Bcm2835_field
+{
+  static_assert(WIDTH > 0 && SHIFT + WIDTH <= 32, "field exceeds register");
+
+  static constexpr uint32_t mask =
+    (WIDTH == 32 ? ~0U : ((1U << WIDTH) - 1)) << SHIFT;
+
+  static constexpr uint32_t val(uint32_t v) { return (v << SHIFT) & mask; }
+  static constexpr uint32_t get(uint32_t reg) { return (reg & mask) >> SHIFT; }
+  static constexpr uint32_t replace(uint32_t reg, uint32_t v)
+  { return (reg & ~mask) | val(v); }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <l4/sys/capability>
+#include <l4/sys/cxx/ipc_iface>
+#include <l4/sys/cxx/ipc_types>
+
+enum
+{
+  I2C_PROTO = 0x45,
+  I2C_XFER_MAX = 64,           ///< Maximum length of either part of a write_read
+  I2C_RESTART_WRITE_MAX = 16,  ///< Maximum write length of a write_read that reads
+};
+
+struct I2C : L4::Kobject_t<I2C, L4::Kobject, I2C_PROTO>
+{
+  /**
+   * Write `wbuf` to the slave at 7 bit address `addr` and read `rlen`
+   * bytes back in one transaction, joined by a repeated start.
+   *
+   * Either part may be empty, so this also covers plain writes and reads.
+   * The write part of a transaction that also reads is limited to
+   * I2C_RESTART_WRITE_MAX bytes, the controller's FIFO; longer ones fail
+   * with -L4_EINVAL.
+   *
+   * \retval -L4_ENODEV     The slave did not acknowledge.
+   * \retval -L4_ETIMEDOUT  The slave stretched the clock for too long.
+   * \retval -L4_EIO        The transfer ended early.
+   */
+  L4_INLINE_RPC(int, write_read,
+                (l4_uint8_t addr,
+                 L4::Ipc::Array<const l4_uint8_t, l4_uint32_t> wbuf,
+                 l4_uint32_t rlen,
+                 L4::Ipc::Array<l4_uint8_t, l4_uint32_t> &rbuf));
+  /// Set the bus clock in Hz.
+  L4_INLINE_RPC(int, set_clock, (l4_uint32_t hz));
+  typedef L4::Typeid::Rpcs<write_read_t, set_clock_t> Rpcs;
+};
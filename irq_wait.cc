@@ -0,0 +1,38 @@
+#include "irq_wait.h"
+
+#include <l4/re/env>
+#include <l4/sys/factory>
+
+#include <utility>
+
+int
+Irq_waiter::bind(L4::Cap<L4vbus::Vbus> vbus, unsigned irqnum,
+                 L4::Cap<L4::Thread> thread)
+{
+  auto irq = L4Re::Util::make_unique_cap<L4::Irq>();
+  if (!irq.is_valid())
+    return -L4_ENOMEM;
+
+  int err = l4_error(L4Re::Env::env()->factory()->create(irq.get()));
+  if (err < 0)
+    return err;
+
+  err = l4_error(vbus->bind(irqnum, irq.get()));
+  if (err < 0)
+    return err;
+
+  err = l4_error(irq->bind_thread(thread, 0));
+  if (err < 0)
+    return err;
+
+  _irq = std::move(irq);
+  return L4_EOK;
+}
+
+/* Unmasks the interrupt and blocks until it fires. The interrupt stays
+ * masked afterwards, so it never reaches the server loop. */
+void
+Irq_waiter::wait(void *arg)
+{
+  static_cast<Irq_waiter *>(arg)->_irq->receive();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <l4/re/util/unique_cap>
+#include <l4/sys/irq>
+#include <l4/sys/thread>
+#include <l4/vbus/vbus>
+
+/**
+ * Interrupt a controller engine blocks on while a transfer is in flight.
+ *
+ * The Irq is bound to the thread running the transfers and only unmasked
+ * by wait(), so it is never delivered to a server loop. wait() matches the
+ * `wait` callbacks of the bcm2835 controller structs.
+ */
+class Irq_waiter
+{
+public:
+  int bind(L4::Cap<L4vbus::Vbus> vbus, unsigned irqnum,
+           L4::Cap<L4::Thread> thread);
+
+  static void wait(void *arg);
+
+private:
+  L4Re::Util::Unique_cap<L4::Irq> _irq;
+};
@@ -1,11 +1,26 @@
 #include "bcm2835.h"
+#include "bitbang.h"
+#include "coalesce.h"
+#include "drdy.h"
+#include "gpio.h"
+#include "gpio_events.h"
+#include "gpio_irq.h"
+#include "gpio_pins.h"
+#include "i2c.h"
+#include "irq_wait.h"
+#include "mmio.h"
+#include "periodic.h"
 #include "spi.h"
+#include "spi_bus.h"
 #include "spi_driver.h"
+#include "timed.h"
+#include "worker.h"
 #include <l4/re/util/br_manager>
 #include <l4/re/util/cap_alloc>
 #include <l4/re/util/object_registry>
 #include <l4/sys/cxx/ipc_epiface>
 #include <l4/sys/irq>
+#include <pthread-l4.h>
 
 #include<string>
 #include<cstring>
@@ -19,18 +34,61 @@ class SPI_Server : public L4::Epiface_t<SPI_Server, SPI> {
 
 private:
   char *data = new char[8];
+  Spi_bus *_bus;
+  L4Re::Util::Br_manager_timeout_hooks *_timeouts;
+  l4_uint8_t _cs;
+  Write_coalescer _coalesce[SPI_CS_MAX];
+  Drdy_trigger _drdy;
+  Periodic_job _jobs[SPI_PERIODIC_MAX];
+  Timed_queue _timed;
+
+  /* Sends out all coalesced writes so that they stay ordered before the
+   * following operation. */
+  void flush_writes() {
+    for (Write_coalescer &c : _coalesce)
+      c.flush();
+  }
+
+  /* Word transfers for transfer16 and transfer32 */
+  template<typename T>
+  int transfer_words(L4::Ipc::Array_ref<const T, l4_uint32_t> const &tbuf,
+                     bool big_endian, L4::Ipc::Array_ref<T, l4_uint32_t> &rbuf) {
+    if (tbuf.length == 0 || tbuf.length > rbuf.length)
+      return -L4_EINVAL;
+
+    flush_writes();
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    _bus->select(_cs);
+    _bus->transfer_words(tbuf.data, rbuf.data, tbuf.length, sizeof(T),
+                         big_endian);
+    rbuf.length = tbuf.length;
+    return L4_EOK;
+  }
 
 public:
+  SPI_Server(Spi_bus *bus, L4Re::Util::Br_manager_timeout_hooks *timeouts,
+             l4_uint8_t cs)
+  : _bus(bus), _timeouts(timeouts), _cs(cs) {}
+
   int op_write(SPI::Rights, L4::Ipc::Array_ref<l4_uint8_t, l4_uint32_t> tbuf) {
     if (tbuf.length > 8)
-      return L4_EINVAL;
-    unsigned char* rbuf = new unsigned char[tbuf.length];
+      return -L4_EINVAL;
+
+    if (_coalesce[_cs].enabled()) {
+      _coalesce[_cs].write(tbuf.data, tbuf.length);
+      return L4_EOK;
+    }
+
+    unsigned char rbuf[8];
 #ifdef DEBUG
     printf("&rbuf: %p, &tbuf: %p, rbuf %x, tbuf: %x, len: %d\n", &rbuf, &tbuf.data,
            rbuf, tbuf.data, tbuf.length);
     fflush(NULL);
 #endif
-    bcm2835_spi_transfernb(tbuf.data, rbuf, tbuf.length);
+    flush_writes();
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    _bus->select(_cs);
+    _bus->transfer(tbuf.data, rbuf, tbuf.length);
     std::memcpy(data, rbuf, MIN(8, tbuf.length));
 
     return L4_EOK;
@@ -45,7 +103,56 @@ public:
            rbuf.data, tbuf.data, tbuf.length);
     fflush(NULL);
 #endif
-    bcm2835_spi_transfernb(tbuf.data, rbuf.data, rbuf.length);
+    flush_writes();
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    _bus->select(_cs);
+    _bus->transfer(tbuf.data, rbuf.data, rbuf.length);
+    std::memcpy(data, rbuf.data, MIN(rbuf.length, 8));
+    return L4_EOK;
+  };
+
+  int op_poll(SPI::Rights, L4::Ipc::Array_ref<const l4_uint8_t, l4_uint32_t> tbuf,
+              l4_uint32_t index, l4_uint8_t mask, l4_uint8_t value,
+              l4_uint32_t interval_us, l4_uint32_t timeout_us,
+              l4_uint8_t &status, l4_uint32_t &polls) {
+    unsigned char rbuf[SPI_POLL_MAX];
+
+    if (tbuf.length == 0 || tbuf.length > SPI_POLL_MAX || index >= tbuf.length
+        || timeout_us > SPI_POLL_TIMEOUT_MAX)
+      return -L4_EINVAL;
+
+    flush_writes();
+    int ready = _bus->poll(_cs, tbuf.data, rbuf, tbuf.length, index, mask,
+                           value, interval_us, timeout_us, &polls);
+    status = rbuf[index];
+    std::memcpy(data, rbuf, MIN(tbuf.length, 8));
+
+    return ready;
+  };
+
+  int op_framed_read(SPI::Rights,
+                     L4::Ipc::Array_ref<const l4_uint8_t, l4_uint32_t> cmd,
+                     l4_uint32_t header_len, l4_uint32_t len_offset,
+                     l4_uint8_t len_width, l4_uint8_t big_endian,
+                     l4_uint32_t max_payload,
+                     L4::Ipc::Array_ref<l4_uint8_t, l4_uint32_t> &rbuf) {
+    l4_uint32_t payload_len;
+
+    if (header_len == 0 || header_len > rbuf.length
+        || max_payload > rbuf.length - header_len
+        || len_width < 1 || len_width > 4
+        || len_width > header_len || len_offset > header_len - len_width)
+      return -L4_EINVAL;
+
+    flush_writes();
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    _bus->select(_cs);
+    if (!_bus->framed_read(cmd.data, cmd.length, rbuf.data, header_len,
+                           len_offset, len_width, big_endian, max_payload,
+                           &payload_len))
+      return -L4_E2BIG;
+
+    rbuf.length = header_len + payload_len;
     std::memcpy(data, rbuf.data, MIN(rbuf.length, 8));
     return L4_EOK;
   };
@@ -60,40 +167,370 @@ public:
         chkcap(server_iface()->rcv_cap<L4::Irq>(0), "failed to recieve irq");
     chksys(server_iface()->realloc_rcv_cap(0), "failed to reallocate cap");
 
-    vbus->bind(54, rirq);
+    vbus->bind(BCM2835_IRQ_SPI, rirq);
+
+    return L4_EOK;
+  }
+
+  int op_arm_drdy(SPI::Rights, l4_uint8_t pin, l4_uint8_t edges,
+                  L4::Ipc::Array_ref<const l4_uint8_t, l4_uint32_t> tbuf,
+                  l4_uint32_t slots, L4::Ipc::Cap<L4Re::Dataspace> &ring) {
+    int err = _drdy.arm(_bus, _cs, pin, edges, tbuf.data, tbuf.length, slots);
+    if (err < 0)
+      return err;
+
+    ring = L4::Ipc::make_cap(_drdy.ring(), L4_CAP_FPAGE_RO);
+    return L4_EOK;
+  }
+
+  int op_disarm_drdy(SPI::Rights) {
+    _drdy.disarm();
+    return L4_EOK;
+  }
+
+  int op_start_periodic(SPI::Rights,
+                        L4::Ipc::Array_ref<const l4_uint8_t, l4_uint32_t> tbuf,
+                        l4_uint32_t period_us, l4_uint32_t slots,
+                        l4_uint32_t &job, L4::Ipc::Cap<L4Re::Dataspace> &ring) {
+    for (job = 0; job < SPI_PERIODIC_MAX; job++)
+      if (!_jobs[job].running())
+        break;
+
+    if (job == SPI_PERIODIC_MAX)
+      return -L4_EBUSY;
+
+    int err = _jobs[job].start(_bus, _cs, tbuf.data, tbuf.length, period_us, slots);
+    if (err < 0)
+      return err;
+
+    ring = L4::Ipc::make_cap(_jobs[job].ring(), L4_CAP_FPAGE_RO);
+    return L4_EOK;
+  }
+
+  int op_stop_periodic(SPI::Rights, l4_uint32_t job) {
+    if (job >= SPI_PERIODIC_MAX || !_jobs[job].running())
+      return -L4_EINVAL;
+
+    _jobs[job].stop();
+    return L4_EOK;
+  }
+
+  int op_chip_select(SPI::Rights, l4_uint8_t cs) {
+    if (cs >= SPI_CS_MAX || !_bus->has_cs(cs))
+      return -L4_EINVAL;
+
+    _cs = cs;
+    return L4_EOK;
+  }
+
+  int op_coalesce(SPI::Rights, l4_uint32_t threshold, l4_uint32_t deadline_us) {
+    return _coalesce[_cs].configure(_timeouts, _bus, _cs, threshold, deadline_us);
+  }
+
+  int op_flush(SPI::Rights) {
+    flush_writes();
+    return L4_EOK;
+  }
+
+  int op_transfer16(SPI::Rights,
+                    L4::Ipc::Array_ref<const l4_uint16_t, l4_uint32_t> tbuf,
+                    l4_uint8_t big_endian,
+                    L4::Ipc::Array_ref<l4_uint16_t, l4_uint32_t> &rbuf) {
+    return transfer_words(tbuf, big_endian, rbuf);
+  }
+
+  int op_transfer32(SPI::Rights,
+                    L4::Ipc::Array_ref<const l4_uint32_t, l4_uint32_t> tbuf,
+                    l4_uint8_t big_endian,
+                    L4::Ipc::Array_ref<l4_uint32_t, l4_uint32_t> &rbuf) {
+    return transfer_words(tbuf, big_endian, rbuf);
+  }
+
+  int op_lossi_write(SPI::Rights,
+                     L4::Ipc::Array_ref<const l4_uint16_t, l4_uint32_t> words) {
+    if (words.length == 0)
+      return -L4_EINVAL;
+
+    flush_writes();
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    _bus->select(_cs);
+    return _bus->write9(words.data, words.length);
+  }
+
+  int op_transfer_gpio(SPI::Rights,
+                       L4::Ipc::Array_ref<const l4_uint8_t, l4_uint32_t> tbuf,
+                       l4_uint32_t pre_set, l4_uint32_t pre_clr,
+                       l4_uint32_t post_set, l4_uint32_t post_clr,
+                       L4::Ipc::Array_ref<l4_uint8_t, l4_uint32_t> &rbuf) {
+    if (tbuf.length > rbuf.length)
+      return -L4_EINVAL;
+
+    flush_writes();
+    std::lock_guard<std::mutex> guard(_bus->lock);
+
+    /* The chip selects of the bus and the own trigger pin may be driven */
+    int err = gpio_pins_check(pre_set | pre_clr | post_set | post_clr,
+                              _bus->gpio_cs_pins() | _drdy.gpio_mask);
+    if (err < 0)
+      return err;
+
+    _bus->select(_cs);
+    if (pre_set)
+      bcm2835_gpio_set_multi(pre_set);
+    if (pre_clr)
+      bcm2835_gpio_clr_multi(pre_clr);
+    _bus->transfer(tbuf.data, rbuf.data, tbuf.length);
+    if (post_set)
+      bcm2835_gpio_set_multi(post_set);
+    if (post_clr)
+      bcm2835_gpio_clr_multi(post_clr);
+
+    rbuf.length = tbuf.length;
+    std::memcpy(data, rbuf.data, MIN(rbuf.length, 8));
+    return L4_EOK;
+  }
+
+  int op_configure_cs(SPI::Rights, l4_uint8_t cs, l4_uint8_t pin,
+                      l4_uint8_t active_high) {
+    if (cs >= SPI_CS_MAX)
+      return -L4_EINVAL;
+
+    if (pin != SPI_CS_HW && pin >= 32)
+      return -L4_EINVAL;
+
+    flush_writes();
+    std::lock_guard<std::mutex> guard(_bus->lock);
+    return _bus->configure_cs(cs, pin == SPI_CS_HW ? Spi_bus::Cs_hw : pin,
+                              active_high);
+  }
+
+  int op_clock(SPI::Rights, l4_uint64_t &now_ns) {
+    now_ns = bcm2835_nanos();
+    return L4_EOK;
+  }
+
+  int op_schedule(SPI::Rights,
+                  L4::Ipc::Array_ref<const l4_uint8_t, l4_uint32_t> tbuf,
+                  l4_uint64_t at_ns, l4_uint32_t &ticket) {
+    if (tbuf.length > SPI_SCHEDULED_MAX)
+      return -L4_EINVAL;
+
+    flush_writes();
+    return _timed.schedule(_bus, _cs, tbuf.data, tbuf.length, at_ns, &ticket);
+  }
+
+  int op_scheduled_result(SPI::Rights, l4_uint32_t ticket,
+                          l4_uint64_t &start_ns, l4_int64_t &lateness_ns,
+                          L4::Ipc::Array_ref<l4_uint8_t, l4_uint32_t> &rbuf) {
+    return _timed.result(ticket, &start_ns, &lateness_ns, rbuf.data,
+                         &rbuf.length);
+  }
+
+  int op_notify_scheduled(SPI::Rights, L4::Ipc::Snd_fpage const &irq) {
+    if (!irq.cap_received())
+      return -L4_EINVAL;
+
+    L4::Cap<L4::Irq> rirq =
+        chkcap(server_iface()->rcv_cap<L4::Irq>(0), "failed to recieve irq");
+    chksys(server_iface()->realloc_rcv_cap(0), "failed to reallocate cap");
+
+    _timed.notify(rirq);
+    return L4_EOK;
+  }
+};
+
+class I2C_Server : public L4::Epiface_t<I2C_Server, I2C> {
+
+private:
+  bcm2835BSC *_ctrl;
+  Irq_waiter _irq;
+
+public:
+  explicit I2C_Server(bcm2835BSC *ctrl) : _ctrl(ctrl) {}
+
+  /* Completion interrupts wake `thread`, the thread serving this object */
+  int enable_irq(L4::Cap<L4::Thread> thread) {
+    int err = _irq.bind(vbus, BCM2835_IRQ_I2C, thread);
+    if (err < 0)
+      return err;
+
+    _ctrl->wait = Irq_waiter::wait;
+    _ctrl->wait_arg = &_irq;
+    return L4_EOK;
+  }
+
+  int op_write_read(I2C::Rights, l4_uint8_t addr,
+                    L4::Ipc::Array_ref<const l4_uint8_t, l4_uint32_t> wbuf,
+                    l4_uint32_t rlen,
+                    L4::Ipc::Array_ref<l4_uint8_t, l4_uint32_t> &rbuf) {
+    if (addr > 0x7f || wbuf.length > I2C_XFER_MAX || rlen > I2C_XFER_MAX
+        || rlen > rbuf.length)
+      return -L4_EINVAL;
+
+    /* Only a write that fits into the FIFO is joined by a repeated start */
+    static_assert(I2C_RESTART_WRITE_MAX <= BCM2835_BSC_FIFO_SIZE,
+                  "restart writes have to fit into the BSC FIFO");
+    if (rlen > 0 && wbuf.length > I2C_RESTART_WRITE_MAX)
+      return -L4_EINVAL;
+
+    switch (bcm2835_bsc_write_read(_ctrl, addr,
+                                   reinterpret_cast<char const *>(wbuf.data),
+                                   wbuf.length,
+                                   reinterpret_cast<char *>(rbuf.data), rlen)) {
+    case BCM2835_I2C_REASON_OK:
+      rbuf.length = rlen;
+      return L4_EOK;
+    case BCM2835_I2C_REASON_ERROR_NACK:
+      return -L4_ENODEV;
+    case BCM2835_I2C_REASON_ERROR_CLKT:
+      return -L4_ETIMEDOUT;
+    default:
+      return -L4_EIO;
+    }
+  }
+
+  int op_set_clock(I2C::Rights, l4_uint32_t hz) {
+    if (hz == 0)
+      return -L4_EINVAL;
+
+    bcm2835_bsc_set_baudrate(_ctrl, hz);
+    return L4_EOK;
+  }
+};
+
+class Gpio_server : public L4::Epiface_t<Gpio_server, Gpio> {
+
+public:
+  int op_pins(Gpio::Rights, l4_uint32_t &mask) {
+    mask = gpio_client_pins;
+    return L4_EOK;
+  }
+
+  int op_configure(Gpio::Rights, l4_uint32_t mask, l4_uint8_t mode) {
+    bcm2835FselBatch pins = BCM2835_FSEL_BATCH_INIT;
+
+    int err = gpio_pins_check(mask, _events.gpio_mask);
+    if (err < 0)
+      return err;
+
+    if (mode != GPIO_MODE_INPUT && mode != GPIO_MODE_OUTPUT)
+      return -L4_EINVAL;
+
+    for (l4_uint8_t pin = 0; pin < 32; pin++)
+      if (mask & (1U << pin))
+        bcm2835_gpio_fsel_stage(&pins, pin,
+                                mode == GPIO_MODE_OUTPUT
+                                    ? BCM2835_GPIO_FSEL_OUTP
+                                    : BCM2835_GPIO_FSEL_INPT);
+    bcm2835_gpio_fsel_commit(&pins);
+    return L4_EOK;
+  }
+
+  int op_set_clr(Gpio::Rights, l4_uint32_t set, l4_uint32_t clr) {
+    int err = gpio_pins_check(set | clr, _events.gpio_mask);
+    if (err < 0)
+      return err;
+
+    if (set)
+      bcm2835_gpio_set_multi(set);
+    if (clr)
+      bcm2835_gpio_clr_multi(clr);
+    return L4_EOK;
+  }
+
+  int op_write(Gpio::Rights, l4_uint32_t value, l4_uint32_t mask) {
+    int err = gpio_pins_check(mask, _events.gpio_mask);
+    if (err < 0)
+      return err;
+
+    bcm2835_gpio_write_mask(value, mask);
+    return L4_EOK;
+  }
+
+  int op_read(Gpio::Rights, l4_uint32_t mask, l4_uint32_t &levels) {
+    levels = bcm2835_gpio_lev_multi(mask);
+    return L4_EOK;
+  }
+
+  int op_arm_events(Gpio::Rights, l4_uint32_t mask, l4_uint8_t edges,
+                    l4_uint32_t slots, L4::Ipc::Cap<L4Re::Dataspace> &ring) {
+    int err = _events.arm(mask, edges, slots);
+    if (err < 0)
+      return err;
 
+    ring = L4::Ipc::make_cap(_events.ring(), L4_CAP_FPAGE_RO);
     return L4_EOK;
   }
+
+  int op_disarm_events(Gpio::Rights) {
+    _events.disarm();
+    return L4_EOK;
+  }
+
+private:
+  Gpio_events _events;
 };
 
-static L4Re::Util::Registry_server<L4Re::Util::Br_manager_hooks> server;
-L4::Io_register_block_mmio *spi;
+static L4Re::Util::Registry_server<L4Re::Util::Br_manager_timeout_hooks> server;
+
+/* Serves `bus` under the capability `name` from its own worker thread */
+static int serve(Bus_worker *worker, Spi_bus *bus, l4_uint8_t cs,
+                 char const *name, Aux_spi_bus *irq_bus = nullptr) {
+  return worker->start([=](Bus_worker::Server &s) {
+    SPI_Server *srv = new SPI_Server(bus, &s, cs);
+    if (!s.registry()->register_obj(srv, name).is_valid()) {
+      delete srv;
+      return -L4_ENOENT;
+    }
+
+    /* The AUX interrupt has to wake the thread that runs the transfers */
+    if (irq_bus && irq_bus->enable_irq(vbus, pthread_self()) < 0)
+      printf("AUX interrupt not available, %s polls\n", name);
+
+    return 0;
+  });
+}
+
+/* Serves the BSC controller `ctrl` under `name` from its own worker thread.
+ * BSC0 and BSC1 share one interrupt, only the one with `irq` set uses it. */
+static int serve_i2c(Bus_worker *worker, bcm2835BSC *ctrl, char const *name,
+                     bool irq) {
+  return worker->start([=](Bus_worker::Server &s) {
+    I2C_Server *srv = new I2C_Server(ctrl);
+    if (!s.registry()->register_obj(srv, name).is_valid()) {
+      delete srv;
+      return -L4_ENOENT;
+    }
+
+    if (irq && srv->enable_irq(Pthread::L4::cap(pthread_self())) < 0)
+      printf("I2C interrupt not available, %s polls\n", name);
+
+    return 0;
+  });
+}
 
 int main(void) {
   printf("starting spi driver\n");
-  L4::Cap<L4vbus::Vbus> vbus = chkcap(
+  vbus = chkcap(
       L4Re::Env::env()->get_cap<L4vbus::Vbus>("vbus"), "vbus cap not valid");
 
-  unsigned long vaddr;
-  chksys(L4Re::Env::env()->rm()->attach(
-             &vaddr, 0xfe2150ff - 0xfe200000,
-             L4Re::Rm::F::Search_addr | L4Re::Rm::F::Cache_uncached |
-                 L4Re::Rm::F::RW,
-             L4::Ipc::make_cap_rw(vbus),
-             0xfe200000, // same address as in io config
-             L4_PAGESHIFT),
+  /* Same addresses as in the io config */
+  chksys(bcm2835_map_peripherals(vbus, BCM2835_RPI4_PERI_BASE),
          "Attach MMIO.");
-  spi = new L4::Io_register_block_mmio(vaddr);
-  printf("registered mmio block\n");
+  printf("registered mmio blocks\n");
 
-  SPI_Server spiserver;
-
-  if (!server.registry()->register_obj(&spiserver, "spi").is_valid()) {
-    printf("Error while registering server object");
+  static Spi0_bus spi0;
+  static Aux_spi_bus spi1(&bcm2835_aux_spi1_ctrl);
+  static Aux_spi_bus spi2(&bcm2835_aux_spi2_ctrl);
+  /* Software SPI on SCLK 22, MOSI 23, MISO 24 and chip selects 25 to 27 */
+  static l4_uint8_t const gpio_cs[] = {25, 26, 27};
+  static Bitbang_spi_bus spi_gpio(22, 23, 24, gpio_cs, 3);
+  static Bus_worker workers[6];
 
-    return -1;
+  if (!bcm2835_init()) {
+    printf("bcm2835_init failed\n");
+    return 1;
   }
-  bcm2835_init();
   if (!bcm2835_spi_begin()) {
     printf("bcm2835_spi_begin failed. Are you running as root??\n");
     return 1;
@@ -103,6 +540,66 @@ int main(void) {
   bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_64);
   bcm2835_spi_chipSelect(BCM2835_SPI_CS1);                 // The default
   bcm2835_spi_setChipSelectPolarity(BCM2835_SPI_CS1, LOW); // the default
+
+  if (serve(&workers[0], &spi0, BCM2835_SPI_CS1, "spi") < 0) {
+    printf("Error while registering server object");
+
+    return -1;
+  }
+
+  /* The AUX SPI controllers are optional, each is served if its
+   * capability exists. SPI1 owns the shared AUX interrupt, SPI2 keeps
+   * polling. */
+  if (L4Re::Env::env()->get_cap<void>("spi1").is_valid()) {
+    if (!bcm2835_auxspi_begin(&bcm2835_aux_spi1_ctrl))
+      printf("bcm2835_auxspi_begin failed for SPI1\n");
+    else if (serve(&workers[1], &spi1, 2, "spi1", &spi1) < 0)
+      printf("Error while registering SPI1\n");
+  }
+
+  if (L4Re::Env::env()->get_cap<void>("spi2").is_valid()) {
+    if (!bcm2835_auxspi_begin(&bcm2835_aux_spi2_ctrl))
+      printf("bcm2835_auxspi_begin failed for SPI2\n");
+    else if (serve(&workers[2], &spi2, 2, "spi2") < 0)
+      printf("Error while registering SPI2\n");
+  }
+
+  if (L4Re::Env::env()->get_cap<void>("spi_gpio").is_valid()) {
+    if (spi_gpio.init(BCM2835_SPI_MODE0, 1000000) < 0)
+      printf("Software SPI pin setup failed\n");
+    else if (serve(&workers[3], &spi_gpio, 0, "spi_gpio") < 0)
+      printf("Error while registering software SPI\n");
+  }
+
+  /* I2C on BSC0 (GPIO 0/1, the HAT ID EEPROM) and BSC1 (GPIO 2/3, the
+   * header I2C bus), each served if its capability exists. BSC1 owns the
+   * shared interrupt, BSC0 keeps polling. */
+  if (L4Re::Env::env()->get_cap<void>("i2c").is_valid()) {
+    if (!bcm2835_bsc_begin(&bcm2835_bsc0_ctrl))
+      printf("bcm2835_bsc_begin failed for BSC0\n");
+    else if (serve_i2c(&workers[4], &bcm2835_bsc0_ctrl, "i2c", false) < 0)
+      printf("Error while registering I2C\n");
+  }
+
+  if (L4Re::Env::env()->get_cap<void>("i2c1").is_valid()) {
+    if (!bcm2835_bsc_begin(&bcm2835_bsc1_ctrl))
+      printf("bcm2835_bsc_begin failed for BSC1\n");
+    else if (serve_i2c(&workers[5], &bcm2835_bsc1_ctrl, "i2c1", true) < 0)
+      printf("Error while registering I2C1\n");
+  }
+
+  /* GPIO requests are short, the main thread serves them */
+  if (L4Re::Env::env()->get_cap<void>("gpio").is_valid()) {
+    static Gpio_server gpio;
+    if (!server.registry()->register_obj(&gpio, "gpio").is_valid())
+      printf("Error while registering GPIO\n");
+  }
+
+  /* The main thread is left with the GPIO interrupt */
+  if (gpio_irq.attach(server.registry(), vbus) < 0)
+    printf("GPIO interrupt not available, "
+           "data-ready triggers and edge events disabled\n");
+
   printf("start spi_driver server loop\n");
   server.loop();
 
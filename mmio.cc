@@ -0,0 +1,60 @@
+#include "mmio.h"
+#include "bcm2835.h"
+
+#include <l4/re/env>
+#include <l4/re/rm>
+
+#include <stdio.h>
+
+struct Mmio_window
+{
+  char const *name;
+  l4_addr_t offset;
+  volatile uint32_t **regs;
+  bool required;
+};
+
+/* One page per block covers all registers the driver touches */
+static Mmio_window const windows[] = {
+  { "ST",   BCM2835_ST_BASE,    &bcm2835_st,   false },
+  { "PADS", BCM2835_GPIO_PADS,  &bcm2835_pads, false },
+  { "CLK",  BCM2835_CLOCK_BASE, &bcm2835_clk,  false },
+  { "GPIO", BCM2835_GPIO_BASE,  &bcm2835_gpio, true },
+  { "SPI0", BCM2835_SPI0_BASE,  &bcm2835_spi0, true },
+  { "BSC0", BCM2835_BSC0_BASE,  &bcm2835_bsc0, false },
+  { "AUX",  BCM2835_AUX_BASE,   &bcm2835_aux,  false },
+  { "BSC1", BCM2835_BSC1_BASE,  &bcm2835_bsc1, false },
+};
+
+int
+bcm2835_map_peripherals(L4::Cap<L4vbus::Vbus> vbus, l4_addr_t peri_base)
+{
+  /* The windows are mapped eagerly: a lazy attach succeeds for a block the
+   * io config does not grant and only faults on first access, so a missing
+   * block has to fail here to stay MAP_FAILED. */
+  for (Mmio_window const &w : windows) {
+    l4_addr_t vaddr = 0;
+    int err = L4Re::Env::env()->rm()->attach(
+        &vaddr, L4_PAGESIZE,
+        L4Re::Rm::F::Search_addr | L4Re::Rm::F::Eager_map |
+            L4Re::Rm::F::Cache_uncached | L4Re::Rm::F::RW,
+        L4::Ipc::make_cap_rw(vbus), peri_base + w.offset, L4_PAGESHIFT);
+
+    if (err < 0) {
+      if (vaddr)
+        L4Re::Env::env()->rm()->detach(vaddr, nullptr);
+
+      if (w.required) {
+        printf("%s registers not available: %d\n", w.name, err);
+        return err;
+      }
+      printf("%s registers not available, not used\n", w.name);
+      continue;
+    }
+
+    *w.regs = reinterpret_cast<volatile uint32_t *>(vaddr);
+  }
+
+  bcm2835_peripherals_base = peri_base;
+  return L4_EOK;
+}
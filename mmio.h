@@ -0,0 +1,16 @@
+#pragma once
+
+#include <l4/sys/types.h>
+#include <l4/vbus/vbus>
+
+/**
+ * Attaches every peripheral block the driver uses as its own window.
+ *
+ * The blocks are taken from a table in mmio.cc; each is attached from the
+ * vbus at `peri_base` plus its BCM2835_*_BASE offset and its virtual
+ * address stored in the matching base pointer, so register accesses need
+ * no address translation. The windows are mapped at once, so a block the
+ * vbus does not provide is found here: optional ones stay MAP_FAILED, a
+ * missing required one makes this return a negative error.
+ */
+int bcm2835_map_peripherals(L4::Cap<L4vbus::Vbus> vbus, l4_addr_t peri_base);
@@ -0,0 +1,82 @@
+#include "periodic.h"
+#include "bcm2835.h"
+
+#include <chrono>
+#include <cstring>
+
+int
+Periodic_job::start(Spi_bus *bus, l4_uint8_t cs, l4_uint8_t const *tbuf, l4_uint32_t len,
+                    l4_uint32_t period_us, l4_uint32_t slots)
+{
+  if (len == 0 || len > Max_len || period_us == 0)
+    return -L4_EINVAL;
+
+  stop();
+
+  int err = _ring.alloc(len, slots);
+  if (err < 0)
+    return err;
+
+  _bus = bus;
+  _cs = cs;
+  _period = period_us;
+  _len = len;
+  std::memcpy(_tbuf, tbuf, len);
+
+  _stop = false;
+  _thread = std::thread(&Periodic_job::run, this);
+  return L4_EOK;
+}
+
+void
+Periodic_job::stop()
+{
+  if (!running())
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stop = true;
+    _wake.notify_one();
+  }
+  _thread.join();
+  _ring.free();
+}
+
+void
+Periodic_job::run()
+{
+  l4_uint8_t rbuf[Max_len];
+  l4_uint64_t next = bcm2835_micros() + _period;
+  l4_uint32_t flags = 0;
+
+  while (!_stop) {
+    /* Sleep through the bulk of the period and spin for the rest, like
+     * bcm2835_delayMicroseconds(). stop() cuts the sleep short. */
+    l4_uint64_t now = bcm2835_micros();
+    if (next > now + 450) {
+      std::unique_lock<std::mutex> guard(_lock);
+      if (_wake.wait_for(guard, std::chrono::microseconds(next - now - 200),
+                         [this] { return _stop.load(); }))
+        break;
+    }
+    bcm2835_delayUntil(next);
+
+    l4_uint64_t start;
+    {
+      std::lock_guard<std::mutex> guard(_bus->lock);
+      _bus->select(_cs);
+      start = bcm2835_micros();
+      _bus->transfer(_tbuf, rbuf, _len);
+    }
+    _ring.push(start, rbuf, _len, flags);
+
+    next += _period;
+    flags = 0;
+    now = bcm2835_micros();
+    if (next <= now) {
+      next += ((now - next) / _period + 1) * _period;
+      flags = RING_F_OVERRUN;
+    }
+  }
+}
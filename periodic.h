@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ring.h"
+#include "spi_bus.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * Periodic sampling job.
+ *
+ * Runs a transfer template every `period_us` microseconds in its own thread
+ * and appends the received bytes with their start timestamp to a shared
+ * ring. The schedule is kept on absolute deadlines, so delays of one sample
+ * do not accumulate; periods that could not be served are skipped and
+ * marked with RING_F_OVERRUN on the next record.
+ */
+class Periodic_job
+{
+public:
+  enum { Max_len = 64 };
+
+  ~Periodic_job() { stop(); }
+
+  int start(Spi_bus *bus, l4_uint8_t cs, l4_uint8_t const *tbuf, l4_uint32_t len,
+            l4_uint32_t period_us, l4_uint32_t slots);
+  void stop();
+
+  bool running() const { return _thread.joinable(); }
+  L4::Cap<L4Re::Dataspace> ring() const { return _ring.ds(); }
+
+private:
+  void run();
+
+  std::thread _thread;
+  std::mutex _lock;
+  std::condition_variable _wake;
+  std::atomic<bool> _stop{false};
+  Spi_bus *_bus;
+  l4_uint8_t _cs;
+  l4_uint32_t _period;
+  l4_uint32_t _len;
+  l4_uint8_t _tbuf[Max_len];
+  Sample_ring _ring;
+};
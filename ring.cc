@@ -0,0 +1,79 @@
+#include "ring.h"
+
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/mem_alloc>
+#include <l4/sys/err.h>
+
+#include <cstring>
+#include <utility>
+
+int
+Sample_ring::alloc(l4_uint32_t data_size, l4_uint32_t slots)
+{
+  if (data_size == 0 || slots == 0 || slots > 65536)
+    return -L4_EINVAL;
+
+  l4_uint32_t n = 1;
+  while (n < slots)
+    n <<= 1;
+
+  l4_uint32_t slot_size = (sizeof(Ring_slot) + data_size + 7) & ~7U;
+  l4_size_t size = l4_round_page(sizeof(Ring_header) + n * slot_size);
+
+  free();
+
+  auto ds = L4Re::Util::make_unique_cap<L4Re::Dataspace>();
+  if (!ds.is_valid())
+    return -L4_ENOMEM;
+
+  auto *env = L4Re::Env::env();
+  int err = env->mem_alloc()->alloc(size, ds.get());
+  if (err < 0)
+    return err;
+
+  L4Re::Rm::Unique_region<Ring_header *> hdr;
+  err = env->rm()->attach(&hdr, size,
+                          L4Re::Rm::F::Search_addr | L4Re::Rm::F::RW,
+                          L4::Ipc::make_cap_rw(ds.get()));
+  if (err < 0)
+    return err;
+
+  Ring_header *h = hdr.get();
+  std::memset(h, 0, size);
+  h->slots = n;
+  h->slot_size = slot_size;
+  h->data_size = data_size;
+  __atomic_store_n(&h->magic, RING_MAGIC, __ATOMIC_RELEASE);
+
+  _ds = std::move(ds);
+  _hdr = std::move(hdr);
+  return L4_EOK;
+}
+
+void
+Sample_ring::free()
+{
+  _hdr.reset();
+  _ds.reset();
+}
+
+void
+Sample_ring::push(l4_uint64_t timestamp, void const *data, l4_uint32_t len,
+                  l4_uint32_t flags)
+{
+  Ring_header *hdr = _hdr.get();
+  l4_uint64_t n = hdr->head;
+  Ring_slot *s = ring_slot(hdr, n);
+
+  __atomic_store_n(&s->seq, 2 * n + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  s->timestamp = timestamp;
+  s->len = len < hdr->data_size ? len : hdr->data_size;
+  s->flags = flags;
+  std::memcpy(s->data(), data, s->len);
+
+  __atomic_store_n(&s->seq, 2 * n + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&hdr->head, n + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <l4/re/dataspace>
+#include <l4/re/rm>
+#include <l4/re/util/unique_cap>
+#include <l4/sys/types.h>
+
+/*
+ * Single-producer ring of fixed-size timestamped records in a dataspace.
+ *
+ * The driver is the only writer. Any number of clients may map the
+ * dataspace read-only and consume it independently: a reader keeps its own
+ * position and compares it against `head`. Every slot carries a sequence
+ * number (odd while record n is written, 2n + 2 once it is valid), so a
+ * reader can tell a slot that was overwritten while it copied it.
+ */
+enum
+{
+  RING_MAGIC = 0x53504952,  // "SPIR"
+};
+
+enum
+{
+  RING_F_OVERRUN = 1,  ///< Periods were skipped before this record
+};
+
+struct Ring_header
+{
+  l4_uint32_t magic;
+  l4_uint32_t slots;      ///< Number of slots, a power of two
+  l4_uint32_t slot_size;  ///< Bytes per slot including the Ring_slot header
+  l4_uint32_t data_size;  ///< Payload bytes per record
+  l4_uint64_t head;       ///< Number of records written so far
+  l4_uint64_t reserved;
+};
+
+struct Ring_slot
+{
+  l4_uint64_t seq;
+  l4_uint64_t timestamp;  ///< Microseconds
+  l4_uint32_t len;        ///< Valid payload bytes
+  l4_uint32_t flags;
+
+  l4_uint8_t *data() { return reinterpret_cast<l4_uint8_t *>(this + 1); }
+  l4_uint8_t const *data() const
+  { return reinterpret_cast<l4_uint8_t const *>(this + 1); }
+};
+
+inline Ring_slot *
+ring_slot(Ring_header *hdr, l4_uint64_t n)
+{
+  l4_addr_t base = reinterpret_cast<l4_addr_t>(hdr + 1);
+  return reinterpret_cast<Ring_slot *>(base + (n & (hdr->slots - 1))
+                                                * hdr->slot_size);
+}
+
+/**
+ * Copy record `n` out of the ring.
+ *
+ * \retval 0           record copied to `slot` and `buf`
+ * \retval -L4_EAGAIN  record `n` has not been written yet
+ * \retval -L4_ERANGE  record `n` was overwritten, the reader fell behind
+ */
+inline int
+ring_read(Ring_header const *hdr, l4_uint64_t n, Ring_slot *slot, void *buf)
+{
+  Ring_header *h = const_cast<Ring_header *>(hdr);
+  Ring_slot const *s = ring_slot(h, n);
+  l4_uint64_t valid = 2 * n + 2;
+
+  l4_uint64_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+  if (seq < valid)
+    return -L4_EAGAIN;
+  if (seq != valid)
+    return -L4_ERANGE;
+
+  *slot = *s;
+  __builtin_memcpy(buf, s->data(), hdr->data_size);
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != valid)
+    return -L4_ERANGE;
+
+  return 0;
+}
+
+/**
+ * Producer side of the ring, owns the dataspace.
+ */
+class Sample_ring
+{
+public:
+  int alloc(l4_uint32_t data_size, l4_uint32_t slots);
+  void free();
+
+  void push(l4_uint64_t timestamp, void const *data, l4_uint32_t len,
+            l4_uint32_t flags = 0);
+
+  bool valid() const { return _hdr.get() != nullptr; }
+  L4::Cap<L4Re::Dataspace> ds() const { return _ds.get(); }
+
+private:
+  L4Re::Util::Unique_cap<L4Re::Dataspace> _ds;
+  L4Re::Rm::Unique_region<Ring_header *> _hdr;
+};
@@ -1,12 +1,30 @@
 #pragma once
 
+#include <l4/re/dataspace>
 #include <l4/sys/capability>
 #include <l4/sys/cxx/ipc_iface>
 #include <l4/sys/cxx/ipc_types>
 
 enum
 {
-  SPI_PROTO = 0x44
+  SPI_PROTO = 0x44,
+  SPI_POLL_MAX = 16,  ///< Maximum length of a poll status transfer
+  SPI_POLL_TIMEOUT_MAX = 1000000,  ///< Maximum poll timeout in microseconds
+  SPI_PERIODIC_MAX = 4,  ///< Periodic jobs per server object
+  SPI_CS_MAX = 8,        ///< Chip selects, controller ones first, see configure_cs()
+  SPI_CS_HW = 0xff,      ///< configure_cs() pin: the controller's own chip select
+  SPI_SCHEDULED_MAX = 64,  ///< Maximum length of a scheduled transfer
+};
+
+enum
+{
+  SPI_EDGE_RISING = 1,
+  SPI_EDGE_FALLING = 2,
+};
+
+enum
+{
+  SPI_LOSSI_DATA = 0x100,  ///< Data bit of a LoSSI word, clear for commands
 };
 
 struct SPI : L4::Kobject_t<SPI, L4::Kobject, SPI_PROTO>
@@ -18,5 +36,157 @@ struct SPI : L4::Kobject_t<SPI, L4::Kobject, SPI_PROTO>
                 (L4::Ipc::Array<l4_uint8_t, l4_uint32_t> tbuf));
   L4_INLINE_RPC(int, read,
                 ( L4::Ipc::Array<l4_uint8_t, l4_uint32_t> &rbuf));
-  typedef L4::Typeid::Rpcs<transfer_t, register_irq_t, read_t, write_t> Rpcs;
+  /**
+   * Repeat the status transfer `tbuf` until `(rx[index] & mask) == value`
+   * or `timeout_us` has elapsed, waiting `interval_us` between two polls.
+   * `timeout_us` is at most SPI_POLL_TIMEOUT_MAX. The bus is released
+   * between two polls. `status` is `rx[index]` of the last poll and
+   * `polls` the number of status transfers, on a timeout as well.
+   *
+   * \retval 1  condition met
+   * \retval 0  timeout
+   */
+  L4_INLINE_RPC(int, poll,
+                (L4::Ipc::Array<const l4_uint8_t, l4_uint32_t> tbuf,
+                 l4_uint32_t index, l4_uint8_t mask, l4_uint8_t value,
+                 l4_uint32_t interval_us, l4_uint32_t timeout_us,
+                 l4_uint8_t *status, l4_uint32_t *polls));
+  /**
+   * Read a length-prefixed frame under a single chip select.
+   *
+   * Sends `cmd`, reads `header_len` bytes, decodes the payload length from
+   * the `len_width` byte field at `len_offset` and reads that many bytes
+   * more. `rbuf` receives header and payload.
+   */
+  L4_INLINE_RPC(int, framed_read,
+                (L4::Ipc::Array<const l4_uint8_t, l4_uint32_t> cmd,
+                 l4_uint32_t header_len, l4_uint32_t len_offset,
+                 l4_uint8_t len_width, l4_uint8_t big_endian,
+                 l4_uint32_t max_payload,
+                 L4::Ipc::Array<l4_uint8_t, l4_uint32_t> &rbuf));
+  /**
+   * Run the transfer `tbuf` on every `edges` (SPI_EDGE_*) of GPIO `pin`.
+   *
+   * The received bytes are appended with a timestamp to a ring (see ring.h)
+   * of `slots` records, returned as read-only dataspace `ring`. Fails with
+   * -L4_EPERM for a pin the driver owns and with -L4_EBUSY for a pin
+   * already used by another trigger, the GPIO edge events or a chip select.
+   */
+  L4_INLINE_RPC(int, arm_drdy,
+                (l4_uint8_t pin, l4_uint8_t edges,
+                 L4::Ipc::Array<const l4_uint8_t, l4_uint32_t> tbuf,
+                 l4_uint32_t slots, L4::Ipc::Out<L4::Cap<L4Re::Dataspace> > ring));
+  L4_INLINE_RPC(int, disarm_drdy, ());
+  /**
+   * Run the transfer `tbuf` every `period_us` microseconds.
+   *
+   * The received bytes are appended with the start timestamp to a ring of
+   * `slots` records, returned as read-only dataspace `ring`. `job`
+   * identifies the job for stop_periodic().
+   */
+  L4_INLINE_RPC(int, start_periodic,
+                (L4::Ipc::Array<const l4_uint8_t, l4_uint32_t> tbuf,
+                 l4_uint32_t period_us, l4_uint32_t slots, l4_uint32_t *job,
+                 L4::Ipc::Out<L4::Cap<L4Re::Dataspace> > ring));
+  L4_INLINE_RPC(int, stop_periodic, (l4_uint32_t job));
+  /**
+   * Select the chip select used by all following operations of this
+   * client, including newly armed triggers and periodic jobs.
+   */
+  L4_INLINE_RPC(int, chip_select, (l4_uint8_t cs));
+  /**
+   * Coalesce writes to the current chip select.
+   *
+   * Writes are buffered until `threshold` bytes are pending or
+   * `deadline_us` has passed since the first buffered write and are then
+   * sent as one burst. Coalesced writes do not update the data returned by
+   * read(). A threshold of 0 disables coalescing.
+   */
+  L4_INLINE_RPC(int, coalesce, (l4_uint32_t threshold, l4_uint32_t deadline_us));
+  /// Send out all coalesced writes.
+  L4_INLINE_RPC(int, flush, ());
+  /**
+   * Write 9 bit LoSSI words, for display controllers with a command/data
+   * bit. Bit 8 (SPI_LOSSI_DATA) marks data words, so commands and their
+   * parameters go out interleaved in one call. SPI0 only.
+   */
+  L4_INLINE_RPC(int, lossi_write,
+                (L4::Ipc::Array<const l4_uint16_t, l4_uint32_t> words));
+  /**
+   * Transfer arrays of 16 or 32 bit words in native byte order.
+   *
+   * The words are sent most significant byte first if `big_endian` is set,
+   * least significant byte first otherwise. `rbuf` receives as many words
+   * as were sent.
+   */
+  L4_INLINE_RPC(int, transfer16,
+                (L4::Ipc::Array<const l4_uint16_t, l4_uint32_t> tbuf,
+                 l4_uint8_t big_endian,
+                 L4::Ipc::Array<l4_uint16_t, l4_uint32_t> &rbuf));
+  L4_INLINE_RPC(int, transfer32,
+                (L4::Ipc::Array<const l4_uint32_t, l4_uint32_t> tbuf,
+                 l4_uint8_t big_endian,
+                 L4::Ipc::Array<l4_uint32_t, l4_uint32_t> &rbuf));
+  /// Current time of the driver clock, the time base of schedule().
+  L4_INLINE_RPC(int, clock, (l4_uint64_t *now_ns));
+  /**
+   * Queue the transfer `tbuf` to start at `at_ns` on the driver clock.
+   *
+   * Returns immediately; the transfer is started from a driver thread and
+   * its result is collected with scheduled_result() using `ticket`.
+   */
+  L4_INLINE_RPC(int, schedule,
+                (L4::Ipc::Array<const l4_uint8_t, l4_uint32_t> tbuf,
+                 l4_uint64_t at_ns, l4_uint32_t *ticket));
+  /**
+   * Collect a scheduled transfer.
+   *
+   * `start_ns` is the time the transfer actually started, `lateness_ns`
+   * its distance to the requested time.
+   *
+   * \retval -L4_EAGAIN  the transfer has not run yet
+   * \retval -L4_ENOENT  unknown or already collected ticket
+   */
+  L4_INLINE_RPC(int, scheduled_result,
+                (l4_uint32_t ticket, l4_uint64_t *start_ns,
+                 l4_int64_t *lateness_ns,
+                 L4::Ipc::Array<l4_uint8_t, l4_uint32_t> &rbuf));
+  /// Trigger `irq` whenever a scheduled transfer has completed.
+  L4_INLINE_RPC(int, notify_scheduled, (L4::Ipc::Cap<L4::Irq> irq));
+  /**
+   * Transfer with GPIO actions around it, e.g. for a reset or D/C line.
+   *
+   * The bank 0 pins in `pre_set` and `pre_clr` are driven high and low
+   * before the chip select is asserted, those in `post_set` and
+   * `post_clr` after it has been released. The same pins as through the
+   * Gpio interface (gpio.h) are available. Pins reserved elsewhere fail
+   * with -L4_EBUSY, except the GPIO chip selects of this bus and the pin
+   * of this session's data-ready trigger.
+   */
+  L4_INLINE_RPC(int, transfer_gpio,
+                (L4::Ipc::Array<const l4_uint8_t, l4_uint32_t> tbuf,
+                 l4_uint32_t pre_set, l4_uint32_t pre_clr,
+                 l4_uint32_t post_set, l4_uint32_t post_clr,
+                 L4::Ipc::Array<l4_uint8_t, l4_uint32_t> &rbuf));
+  /**
+   * Put chip select `cs` on GPIO bank 0 pin `pin`, active high if
+   * `active_high` is set, otherwise active low.
+   *
+   * While a GPIO chip select is selected the controller's own chip selects
+   * stay deasserted. SPI_CS_HW as `pin` gives `cs` back to the controller,
+   * or removes it if the controller has no chip select `cs`.
+   * The same pins as through the Gpio interface (gpio.h) are available;
+   * others fail with -L4_EPERM, pins already used as chip select, by a
+   * data-ready trigger or by the GPIO edge events with -L4_EBUSY. A pin
+   * the chip select moves away from gets back its previous function.
+   */
+  L4_INLINE_RPC(int, configure_cs,
+                (l4_uint8_t cs, l4_uint8_t pin, l4_uint8_t active_high));
+  typedef L4::Typeid::Rpcs<transfer_t, register_irq_t, read_t, write_t,
+                           poll_t, framed_read_t, arm_drdy_t, disarm_drdy_t,
+                           start_periodic_t, stop_periodic_t, chip_select_t,
+                           coalesce_t, flush_t, lossi_write_t, transfer16_t,
+                           transfer32_t, clock_t, schedule_t,
+                           scheduled_result_t, notify_scheduled_t,
+                           transfer_gpio_t, configure_cs_t> Rpcs;
 };
@@ -0,0 +1,277 @@
+#include "spi_bus.h"
+#include "bcm2835.h"
+#include "byteorder.h"
+#include "gpio_pins.h"
+
+#include <cstring>
+#include <pthread-l4.h>
+
+int
+Spi_bus::poll(l4_uint8_t cs, l4_uint8_t const *tbuf, l4_uint8_t *rbuf,
+              l4_uint32_t len, l4_uint32_t index, l4_uint8_t mask,
+              l4_uint8_t value, l4_uint32_t interval_us,
+              l4_uint32_t timeout_us, l4_uint32_t *polls)
+{
+  l4_uint64_t start = bcm2835_micros();
+  l4_uint32_t count = 0;
+  int ready = 0;
+
+  if (index >= len)
+    return -L4_EINVAL;
+
+  for (;;) {
+    /* The bus is only held for one status transfer, so other users of the
+     * bus get their turn between two polls. */
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      select(cs);
+      transfer(tbuf, rbuf, len);
+    }
+    count++;
+
+    if ((rbuf[index] & mask) == value) {
+      ready = 1;
+      break;
+    }
+
+    l4_uint64_t elapsed = bcm2835_micros() - start;
+    if (elapsed >= timeout_us)
+      break;
+
+    if (interval_us)
+      bcm2835_delayMicroseconds(MIN(interval_us, timeout_us - elapsed));
+  }
+
+  if (polls)
+    *polls = count;
+
+  return ready;
+}
+
+int
+Spi_bus::configure_cs(l4_uint8_t cs, l4_uint8_t pin, bool active_high)
+{
+  if (cs >= Cs_max)
+    return -L4_EINVAL;
+
+  Gpio_cs &c = _gpio_cs[cs];
+
+  /* Also for a chip select the controller does not have, whose GPIO is
+   * released that way */
+  if (pin == Cs_hw) {
+    release_gpio_cs(c);
+    return L4_EOK;
+  }
+
+  if (pin >= 32)
+    return -L4_EINVAL;
+
+  l4_uint32_t mask = 1U << pin;
+  if (mask != c.mask) {
+    int err = gpio_pins_claim(mask);
+    if (err < 0)
+      return err;
+
+    release_gpio_cs(c);
+    c.fsel = bcm2835_gpio_get_fsel(pin);
+  }
+
+  /* Park the pin at its inactive level before it becomes an output */
+  if (active_high)
+    bcm2835_gpio_clr_multi(mask);
+  else
+    bcm2835_gpio_set_multi(mask);
+  bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_OUTP);
+
+  c.mask = mask;
+  c.active_high = active_high;
+  return L4_EOK;
+}
+
+/* Gives the pin of a GPIO chip select back with the function it had */
+void
+Spi_bus::release_gpio_cs(Gpio_cs &c)
+{
+  if (!c.mask)
+    return;
+
+  bcm2835_gpio_fsel(__builtin_ctz(c.mask), c.fsel);
+  gpio_pins_release(c.mask);
+  c = Gpio_cs();
+}
+
+void
+Spi_bus::transfer_words(void const *tbuf, void *rbuf, l4_uint32_t count,
+                        unsigned width, bool big_endian)
+{
+  enum { Chunk = 256 };
+  l4_uint8_t buf[Chunk];
+  l4_uint8_t const *tx = static_cast<l4_uint8_t const *>(tbuf);
+  l4_uint8_t *rx = static_cast<l4_uint8_t *>(rbuf);
+  l4_uint32_t per_chunk = Chunk / width;
+  bool swap = bswap_needed(big_endian);
+
+  begin();
+
+  while (count) {
+    l4_uint32_t n = count < per_chunk ? count : per_chunk;
+    l4_uint32_t bytes = n * width;
+
+    if (!swap)
+      std::memcpy(buf, tx, bytes);
+    else if (width == 2)
+      bswap16_copy(buf, tx, n);
+    else
+      bswap32_copy(buf, tx, n);
+
+    count -= n;
+    xfer(buf, rx ? buf : nullptr, bytes, count == 0);
+
+    if (rx) {
+      if (!swap)
+        std::memcpy(rx, buf, bytes);
+      else if (width == 2)
+        bswap16_copy(rx, buf, n);
+      else
+        bswap32_copy(rx, buf, n);
+      rx += bytes;
+    }
+    tx += bytes;
+  }
+
+  end();
+}
+
+int
+Spi_bus::framed_read(l4_uint8_t const *cmd, l4_uint32_t cmd_len,
+                     l4_uint8_t *rbuf, l4_uint32_t hdr_len,
+                     l4_uint32_t len_offset, l4_uint8_t len_width,
+                     bool big_endian, l4_uint32_t max_payload,
+                     l4_uint32_t *payload_len)
+{
+  l4_uint32_t length = 0;
+  int ok = 1;
+
+  if (len_width < 1 || len_width > 4 || len_offset + len_width > hdr_len)
+    return 0;
+
+  begin();
+
+  if (cmd_len)
+    xfer(cmd, nullptr, cmd_len, false);
+
+  xfer(nullptr, rbuf, hdr_len, false);
+
+  for (unsigned i = 0; i < len_width; i++) {
+    l4_uint8_t byte = big_endian ? rbuf[len_offset + i]
+                                 : rbuf[len_offset + len_width - 1 - i];
+    length = (length << 8) | byte;
+  }
+
+  if (length > max_payload)
+    ok = 0;
+  else if (length)
+    xfer(nullptr, rbuf + hdr_len, length, true);
+
+  end();
+
+  if (payload_len)
+    *payload_len = ok ? length : 0;
+
+  return ok;
+}
+
+void
+Spi0_bus::hw_select(l4_uint8_t cs)
+{
+  if (cs == Cs_none)
+    cs = BCM2835_SPI_CS_NONE;
+  bcm2835_spi_chipSelect(cs);
+}
+
+void
+Spi0_bus::hw_begin()
+{
+  bcm2835_spi_transfer_begin();
+}
+
+void
+Spi0_bus::xfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf, l4_uint32_t len,
+               bool)
+{
+  bcm2835_spi_transfer_continue(tbuf, rbuf, len);
+}
+
+void
+Spi0_bus::hw_end()
+{
+  bcm2835_spi_transfer_end();
+}
+
+void
+Spi0_bus::hw_write(l4_uint8_t const *tbuf, l4_uint32_t len)
+{
+  bcm2835_spi_writenb(reinterpret_cast<char const *>(tbuf), len);
+}
+
+int
+Spi0_bus::hw_write9(l4_uint16_t const *words, l4_uint32_t len)
+{
+  bcm2835_spi_lossi_writenb(words, len);
+  return L4_EOK;
+}
+
+void
+Aux_spi_bus::hw_select(l4_uint8_t cs)
+{
+  if (cs == Cs_none)
+    cs = BCM2835_SPI_CS_NONE;
+  bcm2835_auxspi_chipSelect(_ctrl, cs);
+}
+
+void
+Aux_spi_bus::hw_begin()
+{
+  bcm2835_auxspi_transfer_begin(_ctrl);
+  _held = false;
+}
+
+void
+Aux_spi_bus::xfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf, l4_uint32_t len,
+                  bool last)
+{
+  if (!len)
+    return;
+
+  bcm2835_auxspi_transfer_continue(_ctrl,
+                                   reinterpret_cast<char const *>(tbuf),
+                                   reinterpret_cast<char *>(rbuf), len, last);
+  _held = !last;
+}
+
+void
+Aux_spi_bus::hw_end()
+{
+  if (_held)
+    bcm2835_auxspi_transfer_end(_ctrl);
+  _held = false;
+}
+
+void
+Aux_spi_bus::hw_write(l4_uint8_t const *tbuf, l4_uint32_t len)
+{
+  bcm2835_auxspi_writenb(_ctrl, reinterpret_cast<char const *>(tbuf), len);
+}
+
+int
+Aux_spi_bus::enable_irq(L4::Cap<L4vbus::Vbus> vbus, pthread_t thread)
+{
+  int err = _irq.bind(vbus, BCM2835_IRQ_AUX, Pthread::L4::cap(thread));
+  if (err < 0)
+    return err;
+
+  _ctrl->wait_thread = thread;
+  _ctrl->wait = Irq_waiter::wait;
+  _ctrl->wait_arg = &_irq;
+  return L4_EOK;
+}
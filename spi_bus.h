@@ -0,0 +1,263 @@
+#pragma once
+
+#include "bcm2835.h"
+#include "irq_wait.h"
+
+#include <l4/sys/err.h>
+#include <l4/sys/types.h>
+
+#include <mutex>
+#include <pthread.h>
+
+/**
+ * One SPI controller as seen by the server objects.
+ *
+ * The controller specific part is the segmented transfer primitive
+ * hw_begin()/xfer()/hw_end(); everything built on top of it (plain
+ * transfers, status polling, framed reads) is shared by all buses. Callers
+ * hold `lock` around every sequence that touches the controller.
+ *
+ * Chip selects beyond the controller's own can be put on GPIO bank 0 pins
+ * with configure_cs(). While such a chip select is used the controller's
+ * chip selects are parked, and the pin is asserted and released with one
+ * GPSET0/GPCLR0 write around the transfer.
+ */
+class Spi_bus
+{
+public:
+  enum
+  {
+    Cs_max = 8,      ///< Chip selects, controller and GPIO ones
+    Cs_hw = 0xff,    ///< configure_cs() pin: use the controller's chip select
+    Cs_none = 0xff,  ///< hw_select() argument: assert no chip select
+  };
+
+  virtual ~Spi_bus() = default;
+
+  /// Number of chip selects the controller drives.
+  virtual unsigned chip_selects() const = 0;
+
+  /**
+   * Drive chip select `cs` through GPIO `pin`, active high if
+   * `active_high` is set. Cs_hw as `pin` returns `cs` to the controller,
+   * or removes it if the controller has no such chip select.
+   *
+   * The pin is reserved with gpio_pins_claim(), so it has to be a client
+   * pin no one else uses. A pin given up by reconfiguring `cs` gets back
+   * the function it had before.
+   */
+  int configure_cs(l4_uint8_t cs, l4_uint8_t pin, bool active_high);
+
+  /// GPIO bank 0 pins configure_cs() reserved as chip selects.
+  l4_uint32_t gpio_cs_pins() const
+  {
+    l4_uint32_t mask = 0;
+    for (Gpio_cs const &c : _gpio_cs)
+      mask |= c.mask;
+    return mask;
+  }
+
+  /// Whether chip select `cs` exists, on the controller or on a GPIO.
+  bool has_cs(l4_uint8_t cs) const
+  { return cs < Cs_max && (cs < chip_selects() || _gpio_cs[cs].mask); }
+
+  /// Use chip select `cs` for the following transfers.
+  void select(l4_uint8_t cs)
+  {
+    _sel = cs < Cs_max ? _gpio_cs[cs] : Gpio_cs();
+    hw_select(_sel.mask ? (l4_uint8_t)Cs_none : cs);
+  }
+
+  /// Assert the chip select and start a transfer.
+  void begin()
+  {
+    assert_cs();
+    hw_begin();
+  }
+
+  /**
+   * Transfer `len` bytes within a started transfer.
+   *
+   * A null `tbuf` sends zeros, a null `rbuf` discards the received bytes.
+   * `last` announces that no further segment follows, which lets
+   * controllers release the chip select with the final word.
+   */
+  virtual void xfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf, l4_uint32_t len,
+                    bool last) = 0;
+
+  /// Finish the transfer and release the chip select.
+  void end()
+  {
+    hw_end();
+    release_cs();
+  }
+
+  /// Write-only transfer, received bytes are dropped.
+  void write(l4_uint8_t const *tbuf, l4_uint32_t len)
+  {
+    assert_cs();
+    hw_write(tbuf, len);
+    release_cs();
+  }
+
+  /**
+   * Write 9 bit words whose bit 8 is the command/data bit (LoSSI).
+   *
+   * Only controllers with a LoSSI mode support this.
+   */
+  int write9(l4_uint16_t const *words, l4_uint32_t len)
+  {
+    assert_cs();
+    int ret = hw_write9(words, len);
+    release_cs();
+    return ret;
+  }
+
+  void transfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf, l4_uint32_t len)
+  {
+    begin();
+    xfer(tbuf, rbuf, len, true);
+    end();
+  }
+
+  /**
+   * Transfer `count` words of `width` (2 or 4) bytes under one chip select.
+   *
+   * Words go out most significant byte first if `big_endian` is set. The
+   * conversion to and from the byte stream is done in bulk per chunk.
+   * `rbuf` may be null or equal to `tbuf`.
+   */
+  void transfer_words(void const *tbuf, void *rbuf, l4_uint32_t count,
+                      unsigned width, bool big_endian);
+
+  /**
+   * Repeat the status transfer `tbuf` on chip select `cs` until
+   * `(rbuf[index] & mask) == value` or `timeout_us` has elapsed.
+   *
+   * Takes `lock` around every single status transfer, the caller must not
+   * hold it.
+   *
+   * \retval 1              condition met
+   * \retval 0              timeout
+   * \retval -L4_EINVAL     `index` is not within `len`
+   */
+  int poll(l4_uint8_t cs, l4_uint8_t const *tbuf, l4_uint8_t *rbuf,
+           l4_uint32_t len, l4_uint32_t index, l4_uint8_t mask,
+           l4_uint8_t value, l4_uint32_t interval_us, l4_uint32_t timeout_us,
+           l4_uint32_t *polls);
+
+  int framed_read(l4_uint8_t const *cmd, l4_uint32_t cmd_len,
+                  l4_uint8_t *rbuf, l4_uint32_t hdr_len,
+                  l4_uint32_t len_offset, l4_uint8_t len_width,
+                  bool big_endian, l4_uint32_t max_payload,
+                  l4_uint32_t *payload_len);
+
+  std::mutex lock;
+
+protected:
+  /// Use controller chip select `cs`, or none for Cs_none.
+  virtual void hw_select(l4_uint8_t cs) = 0;
+  /// Start a transfer, asserting the controller chip select.
+  virtual void hw_begin() = 0;
+  /// Finish the transfer and release the controller chip select.
+  virtual void hw_end() = 0;
+
+  virtual void hw_write(l4_uint8_t const *tbuf, l4_uint32_t len)
+  {
+    hw_begin();
+    xfer(tbuf, nullptr, len, true);
+    hw_end();
+  }
+
+  virtual int hw_write9(l4_uint16_t const *, l4_uint32_t)
+  { return -L4_ENOSYS; }
+
+private:
+  struct Gpio_cs
+  {
+    l4_uint32_t mask = 0;
+    bool active_high = false;
+    l4_uint8_t fsel = 0;  ///< Function of the pin before it became the CS
+  };
+
+  void release_gpio_cs(Gpio_cs &c);
+
+  void assert_cs()
+  {
+    if (!_sel.mask)
+      return;
+    if (_sel.active_high)
+      bcm2835_gpio_set_multi(_sel.mask);
+    else
+      bcm2835_gpio_clr_multi(_sel.mask);
+  }
+
+  void release_cs()
+  {
+    if (!_sel.mask)
+      return;
+    if (_sel.active_high)
+      bcm2835_gpio_clr_multi(_sel.mask);
+    else
+      bcm2835_gpio_set_multi(_sel.mask);
+  }
+
+  Gpio_cs _gpio_cs[Cs_max];
+  Gpio_cs _sel;
+};
+
+/**
+ * SPI0, the main SPI controller.
+ */
+class Spi0_bus : public Spi_bus
+{
+public:
+  unsigned chip_selects() const override { return 3; }
+  void xfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf, l4_uint32_t len,
+            bool last) override;
+
+protected:
+  void hw_select(l4_uint8_t cs) override;
+  void hw_begin() override;
+  void hw_end() override;
+  void hw_write(l4_uint8_t const *tbuf, l4_uint32_t len) override;
+  int hw_write9(l4_uint16_t const *words, l4_uint32_t len) override;
+};
+
+/**
+ * SPI1 or SPI2 on the AUX block.
+ *
+ * Chip selects keep asserted between words written to TXHOLD, so a
+ * segmented transfer sends its final word through IO.
+ *
+ * After enable_irq() long transfers block on the AUX interrupt instead of
+ * spinning on the status register. The interrupt is shared by both AUX
+ * SPI controllers, so only one of them may use it.
+ */
+class Aux_spi_bus : public Spi_bus
+{
+public:
+  explicit Aux_spi_bus(bcm2835AuxSPI *ctrl) : _ctrl(ctrl) {}
+
+  unsigned chip_selects() const override { return 3; }
+  void xfer(l4_uint8_t const *tbuf, l4_uint8_t *rbuf, l4_uint32_t len,
+            bool last) override;
+
+  /**
+   * Bind the AUX interrupt to `thread`, the bus worker. Only its long
+   * transfers block on the interrupt; transfers from other threads (data
+   * ready handlers, periodic and timed jobs) keep spinning.
+   */
+  int enable_irq(L4::Cap<L4vbus::Vbus> vbus, pthread_t thread);
+
+protected:
+  void hw_select(l4_uint8_t cs) override;
+  void hw_begin() override;
+  void hw_end() override;
+  void hw_write(l4_uint8_t const *tbuf, l4_uint32_t len) override;
+
+private:
+  bcm2835AuxSPI *_ctrl;
+  bool _held = false;
+  Irq_waiter _irq;
+};
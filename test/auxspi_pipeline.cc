@@ -0,0 +1,299 @@
+/*
+ * AUX SPI pipelining check.
+ *
+ * bcm2835_auxspi_writenb() and bcm2835_auxspi_transfernb() run against the
+ * simulated AUX SPI controller, which loops MOSI back to MISO. The bytes
+ * on the wire, the chip select releases and the received bytes are
+ * checked, as are the FIFO levels against overflow and which thread may
+ * sleep on the AUX interrupt. Then writenb is timed in simulated register
+ * accesses against the loop it replaced, which waited for BUSY to drop
+ * after every word.
+ */
+#include "bcm2835.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <thread>
+
+static int failed;
+
+static void
+fail(char const *what)
+{
+  printf("%s\n", what);
+  failed = 1;
+}
+
+static void
+pattern(char *buf, unsigned len, unsigned seed)
+{
+  for (unsigned i = 0; i < len; i++)
+    buf[i] = (char)(seed + i * 7);
+}
+
+static bool
+wire_is(Sim_aux_log const &log, char const *buf, unsigned len)
+{
+  return log.out.size() == len && !memcmp(log.out.data(), buf, len);
+}
+
+static void
+check(bool ok, unsigned len, char const *what, char const *problem)
+{
+  char msg[96];
+
+  if (ok)
+    return;
+  snprintf(msg, sizeof(msg), "%s %u bytes: %s", what, len, problem);
+  fail(msg);
+}
+
+/* Words are 24 bits and no FIFO over- or underflows */
+static void
+fifo_ok(Sim_aux_log const &log, unsigned len, char const *what)
+{
+  check(log.words == (len + 2) / 3, len, what, "not sent in 24 bit words");
+  check(!log.rx_overflows, len, what, "RX FIFO overflow");
+  check(!log.tx_overflows, len, what, "TX FIFO overflow");
+  check(!log.rx_underflows, len, what, "read from an empty RX FIFO");
+}
+
+/* At most one FIFO depth of words is outstanding, which is what keeps the
+// RX FIFO from overflowing, and transfers long enough use all of it.
+*/
+static void
+depth_ok(Sim_aux_log const &log, unsigned len, char const *what)
+{
+  check(log.max_outstanding <= BCM2835_AUX_SPI_FIFO_DEPTH, len, what,
+        "more than one FIFO depth outstanding");
+  if (len > BCM2835_AUX_SPI_IRQ_MIN)
+    check(log.max_outstanding == BCM2835_AUX_SPI_FIFO_DEPTH, len, what,
+          "FIFO not filled");
+}
+
+static void
+correctness(bcm2835AuxSPI *spi)
+{
+  char tbuf[64];
+  char rbuf[64];
+
+  /* Every length up to past a few FIFO depths of 3 byte words, with the
+  // shifter both as fast as the register accesses and slower
+  */
+  for (unsigned bit_ticks : { 1, 4 })
+    for (unsigned len = 1; len <= sizeof(tbuf); len++) {
+      sim_aux_bit_ticks = bit_ticks;
+      pattern(tbuf, len, len);
+
+      Sim_aux_log &log = sim_aux_log(spi, true);
+      bcm2835_auxspi_writenb(spi, tbuf, len);
+      if (!wire_is(log, tbuf, len))
+        fail("writenb: wrong bytes on the wire");
+      if (log.cs_release.size() != 1 || log.cs_release[0] != len)
+        fail("writenb: CS not released exactly once, after the last byte");
+      fifo_ok(log, len, "writenb");
+      depth_ok(log, len, "writenb");
+
+      memset(rbuf, 0, sizeof(rbuf));
+      sim_aux_log(spi, true);
+      bcm2835_auxspi_transfernb(spi, tbuf, rbuf, len);
+      if (!wire_is(log, tbuf, len))
+        fail("transfernb: wrong bytes on the wire");
+      if (memcmp(rbuf, tbuf, len))
+        fail("transfernb: received bytes differ from the loopback");
+      if (log.cs_release.size() != 1 || log.cs_release[0] != len)
+        fail("transfernb: CS not released exactly once, after the last byte");
+      fifo_ok(log, len, "transfernb");
+      depth_ok(log, len, "transfernb");
+    }
+
+  sim_aux_bit_ticks = 1;
+}
+
+/* The model catches a writer that runs more than a FIFO depth ahead of
+// reading RX, which the checks above rely on.
+*/
+static void
+overflow_detected(bcm2835AuxSPI *spi)
+{
+  volatile uint32_t *stat = spi->regs + BCM2835_AUX_SPI_STAT / 4;
+  volatile uint32_t *txhold = spi->regs + BCM2835_AUX_SPI_TXHOLD / 4;
+  volatile uint32_t *io = spi->regs + BCM2835_AUX_SPI_IO / 4;
+
+  Sim_aux_log &log = sim_aux_log(spi, true);
+  bcm2835_auxspi_transfer_begin(spi);
+  for (unsigned i = 0; i < 2 * BCM2835_AUX_SPI_FIFO_DEPTH; i++) {
+    while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_TX_FULL)
+      ;
+    bcm2835_peri_write(txhold, 24u << 24);
+  }
+  bcm2835_peri_write(io, 24u << 24);
+  while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_BUSY)
+    ;
+
+  if (!log.rx_overflows)
+    fail("sim: RX FIFO overflow not detected");
+
+  while (!(bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_RX_EMPTY))
+    (void)bcm2835_peri_read(io);
+}
+
+/* bcm2835_auxspi_writenb() before it kept the TX FIFO filled: one word at
+// a time, each waiting for the shifter before the next one is queued.
+*/
+static void
+writenb_per_word(bcm2835AuxSPI *spi, const char *tbuf, uint32_t len)
+{
+  volatile uint32_t *stat = spi->regs + BCM2835_AUX_SPI_STAT / 4;
+  volatile uint32_t *txhold = spi->regs + BCM2835_AUX_SPI_TXHOLD / 4;
+  volatile uint32_t *io = spi->regs + BCM2835_AUX_SPI_IO / 4;
+
+  const uint8_t *tx = (const uint8_t *)tbuf;
+  uint32_t tx_len = len;
+
+  bcm2835_auxspi_transfer_begin(spi);
+
+  while (tx_len > 0) {
+    while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_TX_FULL)
+      ;
+
+    uint32_t count = tx_len < 3 ? tx_len : 3;
+    uint32_t data = (count * 8) << 24;
+    for (uint32_t i = 0; i < count; i++)
+      data |= (uint32_t)tx[i] << (8 * (2 - i));
+    tx += count;
+    tx_len -= count;
+
+    if (tx_len != 0)
+      bcm2835_peri_write(txhold, data);
+    else
+      bcm2835_peri_write(io, data);
+
+    while (bcm2835_peri_read(stat) & BCM2835_AUX_SPI_STAT_BUSY)
+      ;
+
+    (void)bcm2835_peri_read(io);
+  }
+}
+
+/* Simulated register accesses per byte of a long write */
+template<typename Write>
+static double
+ticks_per_byte(bcm2835AuxSPI *spi, Write write, char const *what,
+               bool pipelined)
+{
+  enum { Len = 3 * 1000 };
+  static char tbuf[Len];
+  pattern(tbuf, Len, 1);
+
+  Sim_aux_log &log = sim_aux_log(spi, true);
+  uint64_t start = sim_accesses();
+  write(spi, tbuf, Len);
+  uint64_t ticks = sim_accesses() - start;
+
+  if (!wire_is(log, tbuf, Len))
+    fail(what);
+  fifo_ok(log, Len, what);
+  if (pipelined)
+    depth_ok(log, Len, what);
+
+  /* The writers return once the last word is shifted out */
+  printf("  %-10s %6.2f accesses/byte, shifter busy %3.0f%%\n", what,
+         (double)ticks / Len, 100.0 * log.busy / ticks);
+  return (double)ticks / Len;
+}
+
+static void
+throughput(bcm2835AuxSPI *spi)
+{
+  for (unsigned bit_ticks : { 1, 4 }) {
+    sim_aux_bit_ticks = bit_ticks;
+    printf("%u accesses per bit:\n", bit_ticks);
+
+    double old = ticks_per_byte(spi, writenb_per_word, "per word", false);
+    double now = ticks_per_byte(spi, bcm2835_auxspi_writenb, "pipelined",
+                                true);
+
+    /* The pipelined loop keeps the shifter busy from word to word */
+    if (now >= old)
+      fail("writenb: pipelining is not faster than waiting for every word");
+    if (now > 8.0 * bit_ticks * 1.02)
+      fail("writenb: shifter idles between pipelined words");
+  }
+}
+
+static unsigned waits;
+
+/* Stands in for the AUX interrupt: the FIFOs have moved on when it returns,
+// and the wakeup came late enough for the shifter to have drained them
+*/
+static void
+count_wait(void *)
+{
+  waits++;
+  sim_idle(2 * BCM2835_AUX_SPI_FIFO_DEPTH * 24 * sim_aux_bit_ticks);
+}
+
+/* Only the thread the interrupt is bound to sleeps, all others spin */
+static void
+wait_thread(bcm2835AuxSPI *spi)
+{
+  char tbuf[64];
+  char rbuf[64];
+  pattern(tbuf, sizeof(tbuf), 3);
+
+  spi->wait = count_wait;
+  spi->wait_thread = pthread_self();
+
+  std::thread other([&] {
+    bcm2835_auxspi_writenb(spi, tbuf, sizeof(tbuf));
+  });
+  other.join();
+  if (waits)
+    fail("writenb: slept on a thread the interrupt is not bound to");
+
+  Sim_aux_log &log = sim_aux_log(spi, true);
+  bcm2835_auxspi_writenb(spi, tbuf, sizeof(tbuf));
+  if (!waits)
+    fail("writenb: did not sleep on the thread the interrupt is bound to");
+  if (!wire_is(log, tbuf, sizeof(tbuf)))
+    fail("writenb: wrong bytes on the wire when sleeping");
+  fifo_ok(log, sizeof(tbuf), "sleeping writenb");
+  depth_ok(log, sizeof(tbuf), "sleeping writenb");
+
+  waits = 0;
+  memset(rbuf, 0, sizeof(rbuf));
+  sim_aux_log(spi, true);
+  bcm2835_auxspi_transfernb(spi, tbuf, rbuf, sizeof(tbuf));
+  if (!waits)
+    fail("transfernb: did not sleep on the thread the interrupt is bound to");
+  if (memcmp(rbuf, tbuf, sizeof(tbuf)))
+    fail("transfernb: received bytes differ from the loopback when sleeping");
+  fifo_ok(log, sizeof(tbuf), "sleeping transfernb");
+  depth_ok(log, sizeof(tbuf), "sleeping transfernb");
+
+  spi->wait = nullptr;
+}
+
+int
+main()
+{
+  sim_init();
+
+  bcm2835AuxSPI *spi = &bcm2835_aux_spi1_ctrl;
+  if (!bcm2835_auxspi_begin(spi)) {
+    printf("bcm2835_auxspi_begin failed\n");
+    return 1;
+  }
+  bcm2835_auxspi_chipSelect(spi, 0);
+
+  correctness(spi);
+  overflow_detected(spi);
+  wait_thread(spi);
+  throughput(spi);
+
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed;
+}
@@ -0,0 +1,136 @@
+/*
+ * Barrier placement check.
+ *
+ * The simulated register file records every register access and every
+ * barrier of helper.h in order. Driver calls are run with two transfer
+ * lengths and the record is checked against the rule of helper.h: a
+ * barrier has to separate the last access to one peripheral block from
+ * the first access to another. Each call also enters and leaves its
+ * peripheral with a barrier, so its first access is fenced and a barrier
+ * follows its last one. The FIFO loops must be free of barriers, so a
+ * call has the same number of barriers at both lengths.
+ */
+#include "bcm2835.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+
+static int failed;
+
+static void
+fail(char const *call, char const *what)
+{
+  printf("%s: %s\n", call, what);
+  failed = 1;
+}
+
+/* Checks the fencing of one record, returns its number of barriers */
+static unsigned
+check_fencing(char const *call, std::vector<Sim_event> const &trace)
+{
+  char const *block = nullptr;
+  bool fenced = false;
+  unsigned barriers = 0;
+
+  for (Sim_event const &e : trace) {
+    if (!e.block) {
+      fenced = true;
+      barriers++;
+      continue;
+    }
+
+    /* The block before the call is unknown, so the first access needs a
+     * barrier too */
+    if (!fenced && (!block || strcmp(block, e.block))) {
+      printf("%s: %s 0x%02x after %s without a barrier\n", call, e.block,
+             e.offset, block ? block : "entry");
+      failed = 1;
+    }
+    block = e.block;
+    fenced = false;
+  }
+
+  if (block && !fenced)
+    fail(call, "leaves the peripheral without a barrier");
+  return barriers;
+}
+
+/* Runs `run` with `len` and twice that, both have to be fenced alike. A
+ * first run with `len` loads cached control words such as the AUX CNTL0,
+ * so that the two compared runs differ in their length only. */
+static void
+check(char const *call, uint32_t len,
+      std::function<void(uint32_t len)> const &run)
+{
+  unsigned barriers[3];
+  size_t events[3];
+
+  for (int i = 0; i < 3; i++) {
+    sim_trace_start();
+    run(i < 2 ? len : 2 * len);
+    std::vector<Sim_event> const &trace = sim_trace_stop();
+    events[i] = trace.size();
+    barriers[i] = check_fencing(call, trace);
+  }
+
+  if (events[2] <= events[1])
+    fail(call, "the longer transfer made no more accesses");
+  if (barriers[1] != barriers[2]) {
+    printf("%s: %u barriers for %u bytes, %u for %u bytes\n", call,
+           barriers[1], (unsigned)len, barriers[2], (unsigned)len * 2);
+    fail(call, "barriers inside the FIFO loop");
+  }
+}
+
+int
+main()
+{
+  static unsigned char tbuf[512];
+  static unsigned char rbuf[512];
+  bcm2835AuxSPI *aux = &bcm2835_aux_spi1_ctrl;
+
+  sim_init();
+  for (unsigned i = 0; i < sizeof(tbuf); i++)
+    tbuf[i] = (unsigned char)(i * 11 + 5);
+
+  if (!bcm2835_spi_begin() || !bcm2835_auxspi_begin(aux)) {
+    printf("controller setup failed\n");
+    return 1;
+  }
+  bcm2835_auxspi_chipSelect(aux, 0);
+
+  check("bcm2835_spi_transfernb", 100, [&](uint32_t len) {
+    memset(rbuf, 0, sizeof(rbuf));
+    bcm2835_spi_transfernb(tbuf, rbuf, len);
+    if (memcmp(rbuf, tbuf, len))
+      fail("bcm2835_spi_transfernb", "received bytes differ");
+  });
+  check("bcm2835_spi_writenb", 100, [&](uint32_t len) {
+    bcm2835_spi_writenb((char const *)tbuf, len);
+  });
+  check("bcm2835_auxspi_writenb", 99, [&](uint32_t len) {
+    bcm2835_auxspi_writenb(aux, (char const *)tbuf, len);
+  });
+  check("bcm2835_auxspi_transfernb", 99, [&](uint32_t len) {
+    memset(rbuf, 0, sizeof(rbuf));
+    bcm2835_auxspi_transfernb(aux, (char const *)tbuf, (char *)rbuf, len);
+    if (memcmp(rbuf, tbuf, len))
+      fail("bcm2835_auxspi_transfernb", "received bytes differ");
+  });
+
+  /* A GPIO chip select around an SPI0 transfer, timed by the ST: every
+   * change of block inside the sequence needs its barrier */
+  check("GPIO chip select around SPI0", 100, [&](uint32_t len) {
+    uint64_t start = bcm2835_st_read();
+    bcm2835_gpio_clr_multi(1U << 25);
+    bcm2835_spi_transfernb(tbuf, rbuf, len);
+    bcm2835_gpio_set_multi(1U << 25);
+    (void)(bcm2835_st_read() - start);
+  });
+
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed;
+}
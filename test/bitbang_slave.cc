@@ -0,0 +1,211 @@
+/*
+ * Bit banged SPI check.
+ *
+ * Bitbang_spi_bus runs against the simulated GPIO bank, where an SPI slave
+ * watches SCLK, MOSI and the chip select through sim_gpio_changed and
+ * drives MISO. In all four modes the bytes exchanged in both directions,
+ * the clock edges per byte and the idle clock level are checked. Then a
+ * transfer at 100 kHz is timed to see that the calibrated delays give
+ * roughly the requested clock.
+ */
+#include "bitbang.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+enum { Sclk = 11, Mosi = 10, Miso = 9, Ce0 = 8, Ce1 = 7 };
+
+static int failed;
+
+static void
+fail(char const *what, unsigned mode)
+{
+  printf("mode %u: %s\n", mode, what);
+  failed = 1;
+}
+
+/* SPI slave on CE0 that answers with `tx` and records MOSI in `rx` */
+struct Slave
+{
+  unsigned mode;
+  std::vector<l4_uint8_t> tx;
+  std::vector<l4_uint8_t> rx;
+  unsigned bit = 0;
+  unsigned edges = 0;
+  bool selected = false;
+  bool clk = false;
+  bool idle_at_select = true;
+
+  bool cpol() const { return mode & 2; }
+  bool cpha() const { return mode & 1; }
+
+  void drive()
+  {
+    unsigned byte = bit / 8;
+    bool level = byte < tx.size() && (tx[byte] >> (7 - bit % 8)) & 1;
+    sim_gpio_drive(1U << Miso, level ? 1U << Miso : 0);
+  }
+
+  void sample(l4_uint32_t out)
+  {
+    if (bit % 8 == 0)
+      rx.push_back(0);
+    rx.back() |= ((out >> Mosi) & 1) << (7 - bit % 8);
+  }
+
+  void changed(l4_uint32_t out)
+  {
+    bool sel = !(out & (1U << Ce0));
+    bool c = out & (1U << Sclk);
+
+    if (sel && !selected) {
+      idle_at_select = idle_at_select && c == cpol();
+      if (!cpha())
+        drive();
+    }
+    selected = sel;
+
+    if (c == clk)
+      return;
+    clk = c;
+    if (!selected)
+      return;
+
+    edges++;
+    bool leading = c != cpol();
+    if (!cpha()) {
+      /* Sample on the leading edge, shift out on the trailing one */
+      if (leading)
+        sample(out);
+      else {
+        bit++;
+        drive();
+      }
+    } else {
+      /* Shift out on the leading edge, sample on the trailing one */
+      if (leading)
+        drive();
+      else {
+        sample(out);
+        bit++;
+      }
+    }
+  }
+};
+
+static Slave *slave;
+
+static void
+gpio_changed(l4_uint32_t out)
+{
+  slave->changed(out);
+}
+
+static void
+exchange(Bitbang_spi_bus &bus, unsigned mode)
+{
+  enum { Len = 37 };
+  l4_uint8_t tbuf[Len];
+  l4_uint8_t rbuf[Len];
+  Slave s;
+
+  s.mode = mode;
+  s.clk = sim_gpio_out() & (1U << Sclk);
+  for (unsigned i = 0; i < Len; i++) {
+    tbuf[i] = (l4_uint8_t)(0xa5 ^ (i * 13));
+    s.tx.push_back((l4_uint8_t)(0x3c + i * 29));
+  }
+  slave = &s;
+
+  memset(rbuf, 0, sizeof(rbuf));
+  bus.select(0);
+  bus.transfer(tbuf, rbuf, Len);
+
+  if (memcmp(rbuf, s.tx.data(), Len))
+    fail("master received the wrong bytes", mode);
+  if (s.rx.size() != Len || memcmp(s.rx.data(), tbuf, Len))
+    fail("slave received the wrong bytes", mode);
+  if (s.edges != 16 * Len)
+    fail("not two clock edges per bit", mode);
+  if (!s.idle_at_select)
+    fail("clock not idle when CS is asserted", mode);
+
+  l4_uint32_t out = sim_gpio_out();
+  if (!!(out & (1U << Sclk)) != s.cpol())
+    fail("clock not idle after the transfer", mode);
+  if (!(out & (1U << Ce0)) || !(out & (1U << Ce1)))
+    fail("chip selects not released", mode);
+}
+
+static l4_uint64_t
+host_micros()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (l4_uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Loose bounds, as the host may preempt the calibration as well as the
+// transfer. Either can be off in a single run, so each of a few runs
+// calibrates afresh and one of them has to land within the bounds.
+*/
+static void
+timing(Bitbang_spi_bus &bus)
+{
+  enum { Hz = 100000, Len = 250, Runs = 3 };
+  static l4_uint8_t tbuf[Len];
+  l4_uint64_t want = 8ULL * Len * 1000000 / Hz;
+
+  sim_gpio_changed = nullptr;
+  for (int run = 0; run < Runs; run++) {
+    if (bus.init(0, Hz) != L4_EOK) {
+      fail("init at 100 kHz failed", 0);
+      return;
+    }
+
+    bus.select(0);
+    l4_uint64_t start = host_micros();
+    bus.transfer(tbuf, nullptr, Len);
+    l4_uint64_t us = host_micros() - start;
+
+    printf("%u bytes at 100 kHz: %llu us, nominal %llu us\n", (unsigned)Len,
+           (unsigned long long)us, (unsigned long long)want);
+    if (us >= want * 7 / 10 && us <= want * 3)
+      return;
+  }
+
+  fail("clock rate far from the requested 100 kHz", 0);
+}
+
+int
+main()
+{
+  l4_uint8_t const cs[] = { Ce0, Ce1 };
+  Bitbang_spi_bus bus(Sclk, Mosi, Miso, cs, 2);
+
+  sim_init();
+
+  if (bus.init(0, 0) != -L4_EINVAL)
+    fail("init accepted a zero clock", 0);
+  if (bus.init(4, 1000000) != -L4_EINVAL)
+    fail("init accepted mode 4", 4);
+
+  for (unsigned mode = 0; mode < 4; mode++) {
+    if (bus.init(mode, 10000000) != L4_EOK) {
+      fail("init failed", mode);
+      continue;
+    }
+    sim_gpio_changed = gpio_changed;
+    exchange(bus, mode);
+    sim_gpio_changed = nullptr;
+  }
+
+  timing(bus);
+
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed;
+}
@@ -0,0 +1,138 @@
+/*
+ * GPIO edge event capture check.
+ *
+ * Gpio_events runs against the simulated GPIO bank with the pin claims and
+ * the shared ring on host memory. Arming is checked for its errors, for the
+ * one read-modify-write of each of GPREN0 and GPFEN0 and for leaving other
+ * pins' detection alone. Edges driven on the pins go through
+ * gpio_irq.handle_irq() and are read back from the ring with ring_read().
+ */
+#include "bcm2835.h"
+#include "gpio.h"
+#include "gpio_events.h"
+#include "gpio_pins.h"
+#include "sim.h"
+
+#include <stdio.h>
+
+static int failed;
+
+static void
+expect(char const *what, long got, long want)
+{
+  if (got == want)
+    return;
+
+  printf("%s: %ld, expected %ld\n", what, got, want);
+  failed = 1;
+}
+
+static volatile uint32_t *
+gpio_reg(unsigned offset)
+{ return bcm2835_gpio + offset / 4; }
+
+/* Expects the ring records from `*next` on to be `pins` with `edges` */
+static void
+expect_records(Gpio_events &ev, l4_uint64_t *next, unsigned n,
+               l4_uint8_t const *pins, l4_uint8_t const *edges)
+{
+  Ring_header const *hdr = static_cast<Ring_header const *>(ev.ring()->mem);
+  expect("ring magic", hdr->magic, RING_MAGIC);
+  expect("records in the ring", hdr->head, *next + n);
+
+  for (unsigned i = 0; i < n; i++, (*next)++) {
+    Ring_slot slot;
+    Gpio_event_record rec;
+    if (ring_read(hdr, *next, &slot, &rec) != 0) {
+      expect("ring_read", 1, 0);
+      continue;
+    }
+    expect("record length", slot.len, sizeof(rec));
+    expect("record pin", rec.pin, pins[i]);
+    expect("record edge", rec.edge, edges[i]);
+  }
+}
+
+int
+main()
+{
+  enum { P5 = 1U << 5, P6 = 1U << 6, P12 = 1U << 12, P13 = 1U << 13 };
+  l4_uint32_t const mask = P5 | P6 | P12;
+  l4_uint8_t const both = GPIO_EDGE_RISING | GPIO_EDGE_FALLING;
+  Gpio_events ev;
+  l4_uint64_t next = 0;
+
+  sim_init();
+  volatile uint32_t *ren = gpio_reg(BCM2835_GPREN0);
+  volatile uint32_t *fen = gpio_reg(BCM2835_GPFEN0);
+  volatile uint32_t *eds = gpio_reg(BCM2835_GPEDS0);
+
+  expect("arm without pins", ev.arm(0, GPIO_EDGE_RISING, 8), -L4_EINVAL);
+  expect("arm without edges", ev.arm(P5, 0, 8), -L4_EINVAL);
+  expect("arm on an SPI0 pin", ev.arm(P5 | (1U << 8), both, 8), -L4_EPERM);
+  gpio_pins_claim(P6);
+  expect("arm on a claimed pin", ev.arm(mask, both, 8), -L4_EBUSY);
+  gpio_pins_release(P6);
+
+  /* Pin 13 detects rising edges for someone else */
+  sim_poke(ren, P13);
+  bcm2835_gpio_fsel(12, BCM2835_GPIO_FSEL_OUTP);
+
+  unsigned ren_writes = sim_writes(ren);
+  unsigned fen_writes = sim_writes(fen);
+  expect("arm", ev.arm(mask, both, 8), L4_EOK);
+  expect("GPREN0 writes per arm", sim_writes(ren) - ren_writes, 1);
+  expect("GPFEN0 writes per arm", sim_writes(fen) - fen_writes, 1);
+  expect("GPREN0 after arm", sim_peek(ren), mask | P13);
+  expect("GPFEN0 after arm", sim_peek(fen), mask);
+  expect("GPIO 12 an input", sim_peek(gpio_reg(BCM2835_GPFSEL1)), 0);
+  expect("pins claimed", gpio_pins_claim(P12), -L4_EBUSY);
+  expect("driving a claimed pin", gpio_pins_check(P12, 0), -L4_EBUSY);
+  expect("driving an own pin", gpio_pins_check(P12, mask), L4_EOK);
+  expect("driving an SPI0 pin", gpio_pins_check(1U << 8, ~0U), -L4_EPERM);
+
+  /* One edge, then two at once in pin order */
+  sim_gpio_drive(P5, P5);
+  gpio_irq.handle_irq();
+  sim_gpio_drive(P5 | P12, P12);
+  gpio_irq.handle_irq();
+  {
+    l4_uint8_t const pins[] = { 5, 5, 12 };
+    l4_uint8_t const edges[] = { GPIO_EDGE_RISING, GPIO_EDGE_FALLING,
+                                 GPIO_EDGE_RISING };
+    expect_records(ev, &next, 3, pins, edges);
+  }
+  expect("GPEDS0 after handling", sim_peek(eds), 0);
+
+  /* An edge on a pin not armed is neither recorded nor acknowledged */
+  sim_gpio_drive(P13, P13);
+  gpio_irq.handle_irq();
+  expect_records(ev, &next, 0, nullptr, nullptr);
+  expect("GPEDS0 of a foreign pin", sim_peek(eds), P13);
+  sim_poke(eds, 0);
+
+  /* Rising edges only on GPIO 5 replaces the previous set */
+  expect("arm again", ev.arm(P5, GPIO_EDGE_RISING, 4), L4_EOK);
+  next = 0;
+  expect("GPREN0 after arm again", sim_peek(ren), P5 | P13);
+  expect("GPFEN0 after arm again", sim_peek(fen), 0);
+  sim_gpio_drive(P5, 0);
+  sim_gpio_drive(P5, P5);
+  gpio_irq.handle_irq();
+  {
+    l4_uint8_t const pins[] = { 5 };
+    l4_uint8_t const edges[] = { GPIO_EDGE_RISING };
+    expect_records(ev, &next, 1, pins, edges);
+  }
+  expect("GPIO 6 given back", gpio_pins_claim(P6 | P12), L4_EOK);
+  gpio_pins_release(P6 | P12);
+
+  ev.disarm();
+  expect("armed after disarm", ev.armed(), false);
+  expect("GPREN0 after disarm", sim_peek(ren), P13);
+  expect("GPFEN0 after disarm", sim_peek(fen), 0);
+  expect("pins after disarm", gpio_pins_claim(mask), L4_EOK);
+
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed;
+}
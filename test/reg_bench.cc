@@ -0,0 +1,130 @@
+/*
+ * Microbenchmark of the inline register accessors in helper.h.
+ *
+ * Times reads and writes of plain memory standing in for a register block
+ * through the barrier and _nb accessors and through Bcm2835_reg, against
+ * an out-of-line call through a virtual register block interface, which is
+ * how the driver accessed registers before the accessors were inlined.
+ * The timings are only reported, as they depend on the CPU, the compiler
+ * and the load of the host. Fails only if the compile-time addressed
+ * Bcm2835_reg does not hit the same register as the base plus offset.
+ */
+#include "helper.h"
+
+#include <chrono>
+#include <cstdio>
+
+enum { Ops = 20000000, Runs = 5, Offset = 0x34 };
+
+alignas(4096) static volatile uint32_t block[1024];
+volatile uint32_t *bench_regs = block;
+
+typedef Bcm2835_reg<bench_regs, Offset> Reg;
+
+namespace {
+
+/* Reference: register block behind a virtual interface, out of line */
+struct Reg_block
+{
+  virtual uint32_t read(unsigned offset) const = 0;
+  virtual void write(unsigned offset, uint32_t value) const = 0;
+  virtual ~Reg_block() = default;
+};
+
+struct Mmio_block : Reg_block
+{
+  __attribute__((noinline)) uint32_t read(unsigned offset) const override
+  { return bench_regs[offset / 4]; }
+
+  __attribute__((noinline)) void write(unsigned offset,
+                                       uint32_t value) const override
+  { bench_regs[offset / 4] = value; }
+};
+
+Mmio_block mmio;
+Reg_block const *volatile regblock = &mmio;
+
+/* Best of Runs runs of Ops calls of `op`, in ns per call */
+template<typename F>
+double
+best_ns(F op)
+{
+  double best = 1e9;
+  for (unsigned r = 0; r < Runs; r++) {
+    auto start = std::chrono::steady_clock::now();
+    op();
+    std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+    if (d.count() / Ops < best)
+      best = d.count() / Ops;
+  }
+  return best;
+}
+
+}
+
+int
+main()
+{
+  volatile uint32_t *paddr = bench_regs + Offset / 4;
+  uint32_t sum = 0;
+  int failed = 0;
+
+  if (Reg::ptr() != paddr) {
+    printf("Bcm2835_reg addresses %p instead of %p\n",
+           (void *)Reg::ptr(), (void *)paddr);
+    failed = 1;
+  }
+  Reg::write(0x1234);
+  if (bcm2835_peri_read(paddr) != 0x1234 || Reg::read_nb() != 0x1234) {
+    printf("Bcm2835_reg does not access the register\n");
+    failed = 1;
+  }
+
+  Reg_block const *rb = regblock;
+  double virt_rd = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      sum += rb->read(Offset);
+  });
+  double virt_wr = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      rb->write(Offset, i);
+  });
+  double peri_rd = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      sum += bcm2835_peri_read(paddr);
+  });
+  double peri_wr = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      bcm2835_peri_write(paddr, i);
+  });
+  double nb_rd = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      sum += bcm2835_peri_read_nb(paddr);
+  });
+  double nb_wr = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      bcm2835_peri_write_nb(paddr, i);
+  });
+  double reg_rd = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      sum += Reg::read_nb();
+  });
+  double reg_wr = best_ns([&] {
+    for (unsigned i = 0; i < Ops; i++)
+      Reg::write_nb(i);
+  });
+
+  printf("ns per access             read   write\n");
+  printf("virtual, out of line    %6.2f  %6.2f\n", virt_rd, virt_wr);
+  printf("bcm2835_peri_*          %6.2f  %6.2f\n", peri_rd, peri_wr);
+  printf("bcm2835_peri_*_nb       %6.2f  %6.2f\n", nb_rd, nb_wr);
+  printf("Bcm2835_reg::*_nb       %6.2f  %6.2f\n", reg_rd, reg_wr);
+
+  if (reg_rd > virt_rd || reg_wr > virt_wr)
+    printf("note: inline _nb access slower than the virtual call\n");
+
+  (void)sum;
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed;
+}
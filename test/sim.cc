@@ -0,0 +1,514 @@
+#include "sim.h"
+#include "bcm2835.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <deque>
+
+namespace {
+
+enum { Words = 1024 };
+
+struct Block
+{
+  char const *name;
+  volatile uint32_t **base;
+  uint32_t regs[Words];
+  unsigned reads[Words];
+  unsigned writes[Words];
+};
+
+Block blocks[] = {
+  { "ST",   &bcm2835_st,   {}, {}, {} },
+  { "PADS", &bcm2835_pads, {}, {}, {} },
+  { "CLK",  &bcm2835_clk,  {}, {}, {} },
+  { "GPIO", &bcm2835_gpio, {}, {}, {} },
+  { "SPI0", &bcm2835_spi0, {}, {}, {} },
+  { "BSC0", &bcm2835_bsc0, {}, {}, {} },
+  { "AUX",  &bcm2835_aux,  {}, {}, {} },
+  { "BSC1", &bcm2835_bsc1, {}, {}, {} },
+};
+
+Block &gpio = blocks[3];
+Block &spi0 = blocks[4];
+Block &aux = blocks[6];
+
+uint64_t accesses;
+std::deque<uint8_t> spi0_rx;
+bool tracing;
+std::vector<Sim_event> trace;
+uint32_t gpio_out;
+uint32_t gpio_in;
+
+Block *
+find(volatile uint32_t *paddr, unsigned *word)
+{
+  for (Block &b : blocks)
+    if (paddr >= b.regs && paddr < b.regs + Words) {
+      *word = paddr - b.regs;
+      return &b;
+    }
+
+  fprintf(stderr, "sim: access to unmapped register %p\n", (void *)paddr);
+  abort();
+}
+
+uint64_t
+host_micros()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* GPIO 0 to 31 that GPFSEL0 to GPFSEL3 make outputs */
+uint32_t
+gpio_outputs()
+{
+  uint32_t mask = 0;
+  for (unsigned pin = 0; pin < 32; pin++) {
+    uint32_t fsel = gpio.regs[BCM2835_GPFSEL0 / 4 + pin / 10];
+    if (((fsel >> (pin % 10) * 3) & BCM2835_GPIO_FSEL_MASK)
+        == BCM2835_GPIO_FSEL_OUTP)
+      mask |= 1U << pin;
+  }
+  return mask;
+}
+
+uint32_t
+gpio_levels()
+{
+  uint32_t out = gpio_outputs();
+  return (gpio_out & out) | (gpio_in & ~out);
+}
+
+void
+gpio_latch(uint32_t out)
+{
+  if (out == gpio_out)
+    return;
+
+  gpio_out = out;
+  if (sim_gpio_changed)
+    sim_gpio_changed(out);
+}
+
+/* Status bits of the SPI0 CS register, which only the model sets */
+uint32_t const spi0_status = BCM2835_SPI0_CS_RXF | BCM2835_SPI0_CS_RXR
+                             | BCM2835_SPI0_CS_TXD | BCM2835_SPI0_CS_RXD
+                             | BCM2835_SPI0_CS_DONE;
+
+enum { Spi0_depth = 16 };
+
+uint32_t
+spi0_read(unsigned word)
+{
+  if (word == BCM2835_SPI0_FIFO / 4) {
+    if (spi0_rx.empty())
+      return 0;
+    uint8_t byte = spi0_rx.front();
+    spi0_rx.pop_front();
+    return byte;
+  }
+
+  uint32_t cs = spi0.regs[word] & ~spi0_status;
+  cs |= BCM2835_SPI0_CS_DONE;
+  if (spi0_rx.size() < Spi0_depth)
+    cs |= BCM2835_SPI0_CS_TXD;
+  if (!spi0_rx.empty())
+    cs |= BCM2835_SPI0_CS_RXD;
+  if (spi0_rx.size() == Spi0_depth)
+    cs |= BCM2835_SPI0_CS_RXF | BCM2835_SPI0_CS_RXR;
+  return cs;
+}
+
+void
+spi0_write(unsigned word, uint32_t value)
+{
+  if (word == BCM2835_SPI0_FIFO / 4) {
+    if (spi0_rx.size() < Spi0_depth)
+      spi0_rx.push_back(value);
+    return;
+  }
+
+  if (value & BCM2835_SPI0_CS_CLEAR_RX)
+    spi0_rx.clear();
+  spi0.regs[word] = value & ~spi0_status;
+}
+
+/* One AUX SPI controller, 16 words of the AUX block from `base` */
+class Aux_spi
+{
+public:
+  explicit Aux_spi(unsigned base) : _base(base) {}
+
+  bool owns(Block const &b, unsigned word) const
+  { return &b == &aux && word >= _base && word < _base + 16; }
+
+  void reset()
+  {
+    _tx.clear();
+    _rx.clear();
+    _shifting = false;
+    _free_at = 0;
+    log = Sim_aux_log();
+  }
+
+  uint32_t read(unsigned word);
+  void write(unsigned word, uint32_t value);
+
+  Sim_aux_log log;
+
+private:
+  enum { Depth = 4 };
+
+  struct Tx_word
+  {
+    uint32_t data;
+    bool keep_cs;
+    uint64_t queued;
+  };
+
+  uint32_t &reg(unsigned offset) { return aux.regs[_base + offset / 4]; }
+  void sync();
+  void start(Tx_word const &w, uint64_t at);
+  void finish();
+
+  unsigned _base;
+  std::deque<Tx_word> _tx;
+  std::deque<uint32_t> _rx;
+  bool _shifting = false;
+  Tx_word _word;
+  uint64_t _done_at = 0;
+  uint64_t _free_at = 0;
+};
+
+Aux_spi aux_spi[] = { Aux_spi((BCM2835_SPI1_BASE - BCM2835_AUX_BASE) / 4),
+                      Aux_spi((BCM2835_SPI2_BASE - BCM2835_AUX_BASE) / 4) };
+
+void
+Aux_spi::start(Tx_word const &w, uint64_t at)
+{
+  uint32_t cntl0 = reg(BCM2835_AUX_SPI_CNTL0);
+  unsigned bits = cntl0 & BCM2835_AUX_SPI_CNTL0_VAR_WIDTH
+                  ? w.data >> 24 : cntl0 & BCM2835_AUX_SPI_CNTL0_SHIFTLEN;
+
+  _word = w;
+  _shifting = true;
+  _done_at = at + (uint64_t)bits * sim_aux_bit_ticks;
+  log.busy += _done_at - at;
+}
+
+/* The shifted word goes out MSB first and comes back into RX right aligned */
+void
+Aux_spi::finish()
+{
+  uint32_t cntl0 = reg(BCM2835_AUX_SPI_CNTL0);
+  uint32_t data = _word.data;
+  unsigned bits;
+
+  if (cntl0 & BCM2835_AUX_SPI_CNTL0_VAR_WIDTH) {
+    bits = data >> 24;
+    data = bits ? (data & 0xffffff) >> (24 - bits) : 0;
+  } else {
+    bits = cntl0 & BCM2835_AUX_SPI_CNTL0_SHIFTLEN;
+    data = bits ? data >> (32 - bits) : 0;
+  }
+
+  for (int shift = bits - 8; shift >= 0; shift -= 8)
+    log.out.push_back(data >> shift);
+  if (!_word.keep_cs)
+    log.cs_release.push_back(log.out.size());
+  log.words++;
+
+  if (_rx.size() == Depth)
+    log.rx_overflows++;
+  else
+    _rx.push_back(data);
+
+  _shifting = false;
+  _free_at = _done_at;
+}
+
+/* Runs the shifter up to the current access */
+void
+Aux_spi::sync()
+{
+  for (;;) {
+    if (_shifting) {
+      if (_done_at > accesses)
+        return;
+      finish();
+    }
+
+    if (_tx.empty())
+      return;
+
+    Tx_word w = _tx.front();
+    _tx.pop_front();
+    start(w, w.queued > _free_at ? w.queued : _free_at);
+  }
+}
+
+uint32_t
+Aux_spi::read(unsigned word)
+{
+  unsigned offset = (word - _base) * 4;
+  sync();
+
+  if (offset == BCM2835_AUX_SPI_STAT) {
+    uint32_t stat = (uint32_t)_tx.size() << BCM2835_AUX_SPI_STAT_TX_LVL_SHIFT
+                    | (uint32_t)_rx.size() << BCM2835_AUX_SPI_STAT_RX_LVL_SHIFT;
+    if (_shifting || !_tx.empty())
+      stat |= BCM2835_AUX_SPI_STAT_BUSY;
+    if (_tx.size() == Depth)
+      stat |= BCM2835_AUX_SPI_STAT_TX_FULL;
+    if (_tx.empty())
+      stat |= BCM2835_AUX_SPI_STAT_TX_EMPTY;
+    if (_rx.size() == Depth)
+      stat |= BCM2835_AUX_SPI_STAT_RX_FULL;
+    if (_rx.empty())
+      stat |= BCM2835_AUX_SPI_STAT_RX_EMPTY;
+    return stat;
+  }
+
+  if (offset == BCM2835_AUX_SPI_PEEK)
+    return _rx.empty() ? 0 : _rx.front();
+
+  if (offset >= BCM2835_AUX_SPI_IO) {
+    if (_rx.empty()) {
+      log.rx_underflows++;
+      return 0;
+    }
+    uint32_t data = _rx.front();
+    _rx.pop_front();
+    return data;
+  }
+
+  return reg(offset);
+}
+
+void
+Aux_spi::write(unsigned word, uint32_t value)
+{
+  unsigned offset = (word - _base) * 4;
+  sync();
+
+  if (offset >= BCM2835_AUX_SPI_IO) {
+    if (_tx.size() == Depth) {
+      log.tx_overflows++;
+      return;
+    }
+    _tx.push_back(Tx_word{value, offset >= BCM2835_AUX_SPI_TXHOLD, accesses});
+    sync();
+    unsigned outstanding = _tx.size() + _shifting + _rx.size();
+    if (outstanding > log.max_outstanding)
+      log.max_outstanding = outstanding;
+    return;
+  }
+
+  reg(offset) = value;
+  if (offset == BCM2835_AUX_SPI_CNTL0
+      && (value & BCM2835_AUX_SPI_CNTL0_CLEARFIFO)) {
+    _tx.clear();
+    _rx.clear();
+  }
+}
+
+uint32_t
+read_reg(Block &b, unsigned word)
+{
+  for (Aux_spi &a : aux_spi)
+    if (a.owns(b, word))
+      return a.read(word);
+
+  if (&b == &spi0 && word <= BCM2835_SPI0_FIFO / 4)
+    return spi0_read(word);
+
+  if (&b == &blocks[0]) {
+    if (word == BCM2835_ST_CLO / 4)
+      return (uint32_t)host_micros();
+    if (word == BCM2835_ST_CHI / 4)
+      return (uint32_t)(host_micros() >> 32);
+  }
+
+  if (&b == &gpio && word == BCM2835_GPLEV0 / 4)
+    return gpio_levels();
+
+  return b.regs[word];
+}
+
+void
+write_reg(Block &b, unsigned word, uint32_t value)
+{
+  for (Aux_spi &a : aux_spi)
+    if (a.owns(b, word)) {
+      a.write(word, value);
+      return;
+    }
+
+  if (&b == &spi0 && word <= BCM2835_SPI0_FIFO / 4) {
+    spi0_write(word, value);
+    return;
+  }
+
+  if (&b == &gpio) {
+    switch (word * 4) {
+    case BCM2835_GPSET0:
+      gpio_latch(gpio_out | value);
+      return;
+    case BCM2835_GPCLR0:
+      gpio_latch(gpio_out & ~value);
+      return;
+    case BCM2835_GPEDS0:
+      b.regs[word] &= ~value;
+      return;
+    }
+  }
+
+  b.regs[word] = value;
+}
+
+}
+
+void (*sim_gpio_changed)(uint32_t out);
+unsigned sim_aux_bit_ticks = 1;
+
+extern "C" uint32_t
+bcm2835_sim_read(volatile uint32_t *paddr)
+{
+  unsigned word;
+  Block *b = find(paddr, &word);
+
+  accesses++;
+  b->reads[word]++;
+  if (tracing)
+    trace.push_back(Sim_event{b->name, word * 4, false});
+  return read_reg(*b, word);
+}
+
+extern "C" void
+bcm2835_sim_write(volatile uint32_t *paddr, uint32_t value)
+{
+  unsigned word;
+  Block *b = find(paddr, &word);
+
+  accesses++;
+  b->writes[word]++;
+  if (tracing)
+    trace.push_back(Sim_event{b->name, word * 4, true});
+  write_reg(*b, word, value);
+}
+
+extern "C" void
+bcm2835_sim_barrier(void)
+{
+  if (tracing)
+    trace.push_back(Sim_event{nullptr, 0, false});
+}
+
+void
+sim_trace_start()
+{
+  trace.clear();
+  tracing = true;
+}
+
+std::vector<Sim_event> const &
+sim_trace_stop()
+{
+  tracing = false;
+  return trace;
+}
+
+void
+sim_init()
+{
+  for (Block &b : blocks) {
+    memset(b.regs, 0, sizeof(b.regs));
+    memset(b.reads, 0, sizeof(b.reads));
+    memset(b.writes, 0, sizeof(b.writes));
+    *b.base = b.regs;
+  }
+
+  accesses = 0;
+  gpio_out = 0;
+  gpio_in = 0;
+  spi0_rx.clear();
+  tracing = false;
+  trace.clear();
+  sim_gpio_changed = nullptr;
+  sim_aux_bit_ticks = 1;
+  for (Aux_spi &a : aux_spi)
+    a.reset();
+
+  if (!bcm2835_init()) {
+    fprintf(stderr, "sim: bcm2835_init() failed\n");
+    abort();
+  }
+}
+
+uint32_t
+sim_peek(volatile uint32_t *paddr)
+{
+  unsigned word;
+  return find(paddr, &word)->regs[word];
+}
+
+void
+sim_poke(volatile uint32_t *paddr, uint32_t value)
+{
+  unsigned word;
+  find(paddr, &word)->regs[word] = value;
+}
+
+unsigned
+sim_reads(volatile uint32_t *paddr)
+{
+  unsigned word;
+  return find(paddr, &word)->reads[word];
+}
+
+unsigned
+sim_writes(volatile uint32_t *paddr)
+{
+  unsigned word;
+  return find(paddr, &word)->writes[word];
+}
+
+uint64_t
+sim_accesses()
+{ return accesses; }
+
+void
+sim_idle(uint64_t ticks)
+{ accesses += ticks; }
+
+void
+sim_gpio_drive(uint32_t mask, uint32_t levels)
+{
+  uint32_t in = (gpio_in & ~mask) | (levels & mask);
+  uint32_t rising = in & ~gpio_in;
+  uint32_t falling = gpio_in & ~in;
+  uint32_t *r = gpio.regs;
+
+  gpio_in = in;
+  r[BCM2835_GPEDS0 / 4] |= (rising & r[BCM2835_GPREN0 / 4])
+                           | (falling & r[BCM2835_GPFEN0 / 4]);
+}
+
+uint32_t
+sim_gpio_out()
+{ return gpio_out; }
+
+Sim_aux_log &
+sim_aux_log(bcm2835AuxSPI const *spi, bool reset)
+{
+  Aux_spi &a = aux_spi[spi == &bcm2835_aux_spi1_ctrl ? 0 : 1];
+  if (reset)
+    a.log = Sim_aux_log();
+  return a.log;
+}
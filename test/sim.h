@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "bcm2835.h"
+
+/*
+ * Simulated register file of the host checks.
+ *
+ * Built with BCM2835_SIM, the accessors of helper.h call
+ * bcm2835_sim_read() and bcm2835_sim_write() instead of touching memory.
+ * Every block bcm2835_map_peripherals() maps is a page of host memory
+ * here with plain register semantics, except for the registers modelled:
+ *
+ *  - ST CLO/CHI count the host's monotonic clock in microseconds.
+ *  - GPSET0/GPCLR0 drive the output latch, GPLEV0 reads it for pins GPFSEL
+ *    makes outputs and the levels given to sim_gpio_drive() for the rest.
+ *  - GPEDS0 collects the edges sim_gpio_drive() makes on pins enabled in
+ *    GPREN0/GPFEN0, writing 1 clears a bit.
+ *  - SPI0 loops every byte written to FIFO straight back into a 16 byte
+ *    RX FIFO. CS reports TXD while it has room, RXD while it holds data,
+ *    and DONE always; CLEAR_RX empties it.
+ *  - The AUX SPI controllers have 4 word TX and RX FIFOs, a shifter that
+ *    loops MOSI back to MISO and STAT reporting all of it. Words written
+ *    to IO release the chip select when shifted, TXHOLD keeps it.
+ *
+ * Every access is counted, per register and in total. The access count is
+ * the model's time base: the AUX shifter takes sim_aux_bit_ticks accesses
+ * per bit, so a driver loop that wastes register accesses while the
+ * shifter is idle shows up as lower throughput.
+ *
+ * The barriers of helper.h call bcm2835_sim_barrier(), which lets
+ * sim_trace() record them in order with the register accesses.
+ */
+
+/// Point the block bases at the simulated pages and run bcm2835_init().
+void sim_init();
+
+/// Register value without the side effects of a read.
+uint32_t sim_peek(volatile uint32_t *paddr);
+/// Set a register without the side effects of a write.
+void sim_poke(volatile uint32_t *paddr, uint32_t value);
+
+/// Reads and writes of the register at `paddr`.
+unsigned sim_reads(volatile uint32_t *paddr);
+unsigned sim_writes(volatile uint32_t *paddr);
+/// Register accesses since sim_init().
+uint64_t sim_accesses();
+/// Let `ticks` accesses worth of time pass without an access.
+void sim_idle(uint64_t ticks);
+
+/// A register access or, with `block` null, a barrier.
+struct Sim_event
+{
+  char const *block;  ///< Name of the peripheral block
+  unsigned offset;    ///< Byte offset of the register in the block
+  bool write;
+};
+
+/// Start recording accesses and barriers, dropping an earlier record.
+void sim_trace_start();
+/// Stop recording and return what was recorded.
+std::vector<Sim_event> const &sim_trace_stop();
+
+/// Drive the input pins in `mask` to `levels`, detecting edges.
+void sim_gpio_drive(uint32_t mask, uint32_t levels);
+/// Output latch of GPIO 0 to 31.
+uint32_t sim_gpio_out();
+/// Called after each write that changes the output latch.
+extern void (*sim_gpio_changed)(uint32_t out);
+
+/// Register accesses one bit takes on the AUX SPI shifter.
+extern unsigned sim_aux_bit_ticks;
+
+/// What one AUX SPI controller did since sim_init() or the last reset.
+struct Sim_aux_log
+{
+  std::vector<uint8_t> out;        ///< Bytes shifted out
+  std::vector<size_t> cs_release;  ///< Positions in `out` where CS went up
+  unsigned rx_overflows = 0;       ///< Words shifted in while RX was full
+  unsigned tx_overflows = 0;       ///< Words written while TX was full
+  unsigned rx_underflows = 0;      ///< IO reads while RX was empty
+  unsigned words = 0;              ///< Words shifted
+  unsigned max_outstanding = 0;    ///< Most words queued, shifting or unread
+  uint64_t busy = 0;               ///< Accesses during which it shifted
+};
+
+/// Log of AUX SPI controller `spi`, with `reset` cleared beforehand.
+Sim_aux_log &sim_aux_log(bcm2835AuxSPI const *spi, bool reset = false);
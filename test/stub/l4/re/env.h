@@ -0,0 +1,7 @@
+#pragma once
+
+#include <l4/sys/kip.h>
+
+inline l4_kernel_info_t *
+l4re_kip()
+{ return nullptr; }
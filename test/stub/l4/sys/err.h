@@ -0,0 +1,19 @@
+#pragma once
+
+/* Host stand-in for the L4 error codes, which are the POSIX errno values */
+
+enum
+{
+  L4_EOK       = 0,
+  L4_EPERM     = 1,
+  L4_ENOENT    = 2,
+  L4_EIO       = 5,
+  L4_EAGAIN    = 11,
+  L4_ENOMEM    = 12,
+  L4_EBUSY     = 16,
+  L4_ENODEV    = 19,
+  L4_EINVAL    = 22,
+  L4_ERANGE    = 34,
+  L4_ENOSYS    = 38,
+  L4_ETIMEDOUT = 110,
+};
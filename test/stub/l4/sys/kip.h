@@ -0,0 +1,16 @@
+#pragma once
+
+/* Host stand-in for the KIP clock, the host's monotonic clock */
+
+#include <stdint.h>
+#include <time.h>
+
+typedef struct l4_kernel_info_t l4_kernel_info_t;
+
+inline uint64_t
+l4_kip_clock(l4_kernel_info_t *)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
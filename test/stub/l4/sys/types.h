@@ -0,0 +1,30 @@
+#pragma once
+
+/* Host stand-in for the L4 types, message tags and page arithmetic */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t l4_uint8_t;
+typedef uint16_t l4_uint16_t;
+typedef uint32_t l4_uint32_t;
+typedef uint64_t l4_uint64_t;
+typedef int32_t l4_int32_t;
+typedef int64_t l4_int64_t;
+typedef unsigned long l4_umword_t;
+typedef unsigned long l4_addr_t;
+typedef size_t l4_size_t;
+
+/* Result of an IPC, here always a success */
+typedef struct l4_msgtag_t
+{
+  long raw = 0;
+} l4_msgtag_t;
+
+inline long
+l4_error(l4_msgtag_t tag)
+{ return tag.raw < 0 ? tag.raw : 0; }
+
+inline l4_addr_t
+l4_round_page(l4_addr_t size)
+{ return (size + 4095) & ~4095UL; }
@@ -0,0 +1,149 @@
+#include "timed.h"
+#include "bcm2835.h"
+
+#include <chrono>
+#include <cstring>
+
+int
+Timed_queue::schedule(Spi_bus *bus, l4_uint8_t cs, l4_uint8_t const *tbuf,
+                      l4_uint32_t len, l4_uint64_t at_ns, l4_uint32_t *ticket)
+{
+  if (len == 0 || len > Max_len)
+    return -L4_EINVAL;
+
+  std::lock_guard<std::mutex> guard(_lock);
+  unsigned idx;
+  for (idx = 0; idx < Slots; idx++)
+    if (_slots[idx].state == Free)
+      break;
+
+  if (idx == Slots)
+    return -L4_EBUSY;
+
+  Slot &s = _slots[idx];
+  s.state = Queued;
+  s.ticket = _next_ticket++;
+  s.bus = bus;
+  s.cs = cs;
+  s.len = len;
+  s.at = at_ns;
+  std::memcpy(s.buf, tbuf, len);
+
+  /* Insert behind all entries with the same or an earlier deadline */
+  unsigned pos = _queued;
+  while (pos > 0 && _slots[_order[pos - 1]].at > at_ns) {
+    _order[pos] = _order[pos - 1];
+    pos--;
+  }
+  _order[pos] = idx;
+  _queued++;
+
+  if (!_thread.joinable()) {
+    _stop = false;
+    _thread = std::thread(&Timed_queue::run, this);
+  }
+
+  *ticket = s.ticket;
+  _changed.notify_one();
+  return L4_EOK;
+}
+
+Timed_queue::Slot *
+Timed_queue::find(l4_uint32_t ticket)
+{
+  for (Slot &s : _slots)
+    if (s.state != Free && s.ticket == ticket)
+      return &s;
+  return nullptr;
+}
+
+/* Collects a completed transfer and frees its slot. Returns -L4_EAGAIN
+ * while the transfer is still pending. */
+int
+Timed_queue::result(l4_uint32_t ticket, l4_uint64_t *start_ns,
+                    l4_int64_t *lateness_ns, l4_uint8_t *rbuf,
+                    l4_uint32_t *len)
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  Slot *s = find(ticket);
+  if (!s)
+    return -L4_ENOENT;
+
+  if (s->state != Done)
+    return -L4_EAGAIN;
+
+  if (*len < s->len)
+    return -L4_EINVAL;
+
+  std::memcpy(rbuf, s->buf, s->len);
+  *len = s->len;
+  *start_ns = s->start;
+  *lateness_ns = (l4_int64_t)(s->start - s->at);
+  s->state = Free;
+  return L4_EOK;
+}
+
+void
+Timed_queue::notify(L4::Cap<L4::Irq> irq)
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  _irq = irq;
+}
+
+void
+Timed_queue::stop()
+{
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (!_thread.joinable())
+      return;
+
+    _stop = true;
+    _changed.notify_one();
+  }
+  _thread.join();
+}
+
+void
+Timed_queue::run()
+{
+  std::unique_lock<std::mutex> guard(_lock);
+
+  while (!_stop) {
+    if (!_queued) {
+      _changed.wait(guard);
+      continue;
+    }
+
+    /* Sleep until the spin window of the earliest deadline. A newly queued
+     * earlier transfer wakes the thread up and is looked at first. */
+    Slot &s = _slots[_order[0]];
+    l4_uint64_t now = bcm2835_nanos();
+    if (s.at > now + Spin_ns) {
+      _changed.wait_for(guard, std::chrono::nanoseconds(s.at - now - Spin_ns));
+      continue;
+    }
+
+    _queued--;
+    std::memmove(_order, _order + 1, _queued);
+    s.state = Running;
+    guard.unlock();
+
+    /* The bus is taken before the final spin, so that no transfer of
+     * another client can start right in front of the deadline. */
+    l4_uint64_t start;
+    {
+      std::lock_guard<std::mutex> bus_guard(s.bus->lock);
+      s.bus->select(s.cs);
+      while ((start = bcm2835_nanos()) < s.at)
+        ;
+      s.bus->transfer(s.buf, s.buf, s.len);
+    }
+
+    guard.lock();
+    s.start = start;
+    s.state = Done;
+    if (_irq.is_valid())
+      _irq->trigger();
+  }
+}
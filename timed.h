@@ -0,0 +1,69 @@
+#pragma once
+
+#include "spi_bus.h"
+
+#include <l4/sys/irq>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * Transfers scheduled for an absolute time.
+ *
+ * Each transfer is queued with its deadline on the bcm2835_nanos() time
+ * base and identified by a ticket. A worker thread takes the queue in
+ * deadline order, sleeps until shortly before the earliest deadline and
+ * spins for the rest, like bcm2835_delayMicroseconds(). The received
+ * bytes, the actual start time and the lateness stay in the slot until
+ * they are collected with result(); the optional Irq is triggered after
+ * every completed transfer.
+ */
+class Timed_queue
+{
+public:
+  enum
+  {
+    Max_len = 64,
+    Slots = 16,
+    Spin_ns = 200000,  ///< Final part of the wait that is spun, not slept
+  };
+
+  ~Timed_queue() { stop(); }
+
+  int schedule(Spi_bus *bus, l4_uint8_t cs, l4_uint8_t const *tbuf,
+               l4_uint32_t len, l4_uint64_t at_ns, l4_uint32_t *ticket);
+  int result(l4_uint32_t ticket, l4_uint64_t *start_ns,
+             l4_int64_t *lateness_ns, l4_uint8_t *rbuf, l4_uint32_t *len);
+  void notify(L4::Cap<L4::Irq> irq);
+  void stop();
+
+private:
+  enum State { Free, Queued, Running, Done };
+
+  struct Slot
+  {
+    State state = Free;
+    l4_uint32_t ticket;
+    Spi_bus *bus;
+    l4_uint8_t cs;
+    l4_uint32_t len;
+    l4_uint64_t at;
+    l4_uint64_t start;
+    l4_uint8_t buf[Max_len];  ///< Sent bytes, replaced by the received ones
+  };
+
+  void run();
+  Slot *find(l4_uint32_t ticket);
+
+  std::mutex _lock;
+  std::condition_variable _changed;
+  std::thread _thread;
+  bool _stop = false;
+  l4_uint32_t _next_ticket = 1;
+  L4::Cap<L4::Irq> _irq;
+  Slot _slots[Slots];
+  /* Queued slots by deadline, earliest first */
+  l4_uint8_t _order[Slots];
+  unsigned _queued = 0;
+};
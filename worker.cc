@@ -0,0 +1,46 @@
+#include "worker.h"
+
+#include <l4/re/env>
+#include <pthread-l4.h>
+
+int
+Bus_worker::start(std::function<int(Server &)> const &setup)
+{
+  _ready = false;
+  _thread = std::thread(&Bus_worker::run, this, std::cref(setup));
+
+  std::unique_lock<std::mutex> guard(_lock);
+  _done.wait(guard, [this] { return _ready; });
+
+  int result = _result;
+  guard.unlock();
+
+  if (result < 0)
+    _thread.join();
+  else
+    _thread.detach();
+
+  return result;
+}
+
+void
+Bus_worker::run(std::function<int(Server &)> const &setup)
+{
+  /* The server has to live on this thread: it takes the UTCB of the
+   * constructing thread and binds all gates to the given one. */
+  Server server(Pthread::L4::cap(pthread_self()),
+                L4Re::Env::env()->factory());
+
+  int result = setup(server);
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _result = result;
+    _ready = true;
+  }
+  _done.notify_one();
+
+  if (result < 0)
+    return;
+
+  server.loop();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <l4/re/util/br_manager>
+#include <l4/re/util/object_registry>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Server thread of one bus.
+ *
+ * Every bus runs its own server loop, so requests to different buses are
+ * handled concurrently. The IPC gates of the objects registered in
+ * `setup` are bound to the worker thread, which is all the routing the
+ * kernel needs to deliver a request to the thread owning its bus.
+ */
+class Bus_worker
+{
+public:
+  typedef L4Re::Util::Registry_server<L4Re::Util::Br_manager_timeout_hooks>
+    Server;
+
+  /**
+   * Start the thread, run `setup` on it and then the server loop.
+   *
+   * Returns the result of `setup` once it finished. On a negative result
+   * the thread exits without entering the loop.
+   */
+  int start(std::function<int(Server &)> const &setup);
+
+private:
+  void run(std::function<int(Server &)> const &setup);
+
+  std::thread _thread;
+  std::mutex _lock;
+  std::condition_variable _done;
+  bool _ready = false;
+  int _result = 0;
+};